@@ -25,10 +25,37 @@
  * ============================================================ */
 
 #include "spacenav-orocos.hpp"
+#include "../spacenav-trace.hpp"
 #include <rtt/extras/FileDescriptorActivity.hpp>
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sstream>
 
 using namespace cosima::hw;
 
+#ifdef USE_RSTRT
+namespace
+{
+/**
+ * Euler increments to quaternion (w, x, y, z) with the convention of RST-RT.
+ */
+struct RstrtEuler
+{
+    rstrt::geometry::Rotation *rotation;
+
+    void operator()(float a, float b, float c, float q[4])
+    {
+        const Eigen::Quaternionf e = rotation->euler2Quaternion(a, b, c);
+        q[0] = e.w();
+        q[1] = e.x();
+        q[2] = e.y();
+        q[3] = e.z();
+    }
+};
+} // namespace
+#endif
+
 SpaceNavOrocos::SpaceNavOrocos(std::string const &name) : RTT::TaskContext(name),
                                                           offsetTranslation(0.001),
                                                           offsetOrientation(0.001),
@@ -47,14 +74,66 @@ SpaceNavOrocos::SpaceNavOrocos(std::string const &name) : RTT::TaskContext(name)
                                                           cageMaxX(0.65),
                                                           cageMaxY(0.5),
                                                           cageMaxZ(0.6),
-                                                          isCageActive(false)
+                                                          isCageActive(false),
+                                                          rtHardening(false),
+                                                          rtPriority(80),
+                                                          rtCpu(-1),
+                                                          rtLockMemory(true),
+                                                          rtPrefaultStack(256 * 1024),
+                                                          rtHardeningPending(false),
+                                                          rtHardeningSucceeded(false),
+                                                          rtMajorFaults(-1),
+                                                          rtFaultCheckCounter(0),
+                                                          traceAttachPending(false),
+                                                          predictionEnabled(false),
+                                                          predictionLatency(0.0),
+                                                          predictionAlpha(0.5),
+                                                          predictionBeta(0.1),
+                                                          predictionRmsTranslation(0.0),
+                                                          predictionRmsRotation(0.0),
+                                                          predictionLastTimestamp(-1),
+                                                          metricsFile(""),
+                                                          metricsPeriod(1.0),
+                                                          autoCalibration(false),
+                                                          calibrationSigma(4.0),
+                                                          calibrationPeriod(1.0),
+                                                          connectionCheckInterval(0.1),
+                                                          connectionCheckTimestamp(0),
+                                                          out6dConnected(false),
+                                                          commandConnected(false),
+                                                          buttonEventConnected(false)
+#ifdef USE_RSTRT
+                                                          ,
+                                                          shapingEnabled(false),
+                                                          shapingPeriod(0.008),
+                                                          shapingMaxVelocityT(0.25),
+                                                          shapingMaxAccelerationT(1.0),
+                                                          shapingMaxJerkT(10.0),
+                                                          shapingMaxVelocityR(1.0),
+                                                          shapingMaxAccelerationR(4.0),
+                                                          shapingMaxJerkR(40.0),
+                                                          shapingLastUpdate(-1),
+                                                          shapingTimerActive(false),
+                                                          numChannels(1),
+                                                          channelBlending(true),
+                                                          channelSelectButton(-1),
+                                                          channelBlendButton(-1),
+                                                          appliedCageActive(false),
+                                                          commandFrame(cosima::hw::SPACENAV_FRAME_DEFAULT),
+                                                          poseOutputConnected(false)
+#endif
 {
     addOperation("displayStatus", &SpaceNavOrocos::displayStatus, this).doc("Display the current status of this component.");
+    addOperation("resetPredictionStatistics", &SpaceNavOrocos::resetPredictionStatistics, this).doc("Clear the prediction error statistics.");
+    addOperation("refreshConnections", &SpaceNavOrocos::refreshConnections, this, RTT::OwnThread).doc("Check which outputs are connected right away instead of within connectionCheckInterval.");
 #ifdef USE_RSTRT
-    addOperation("resetOrientation", &SpaceNavOrocos::resetOrientation, this).doc("Reset the orientation to new quaternion values.");
-    addOperation("resetPoseToInitial", &SpaceNavOrocos::resetPoseToInitial, this).doc("Reset the entire pose to the initial one.");
-    addOperation("resetPose", &SpaceNavOrocos::resetPose, this).doc("Reset the pose to a new one.");
+    addOperation("resetOrientation", &SpaceNavOrocos::resetOrientation, this, RTT::OwnThread).doc("Reset the orientation to new quaternion values.");
+    addOperation("resetPoseToInitial", &SpaceNavOrocos::resetPoseToInitial, this, RTT::OwnThread).doc("Reset the entire pose to the initial one.");
+    addOperation("resetPose", &SpaceNavOrocos::resetPose, this, RTT::OwnThread).doc("Reset the pose to a new one.");
     addOperation("setInitialRotation", &SpaceNavOrocos::setInitialRotation, this).doc("Set the rotation before the component is started.");
+    addOperation("resetChannelPose", &SpaceNavOrocos::resetChannelPose, this, RTT::OwnThread).doc("Reset the pose of a channel to a new one, also drives a channel without connected current pose.");
+    addOperation("selectChannel", &SpaceNavOrocos::selectChannel, this, RTT::OwnThread).doc("Select the channel which is moved if channelBlending is off.");
+    addOperation("setCommandReference", &SpaceNavOrocos::setCommandReference, this, RTT::OwnThread).doc("Set the rotation of the reference command frame (commandFrame 3).");
 #endif
 
     addProperty("sensitivity", sensitivity);
@@ -76,18 +155,67 @@ SpaceNavOrocos::SpaceNavOrocos(std::string const &name) : RTT::TaskContext(name)
     addProperty("cageMaxY", cageMaxY);
     addProperty("cageMaxZ", cageMaxZ);
     addProperty("isCageActive", isCageActive);
+
+    addProperty("rtHardening", rtHardening).doc("Harden the reading thread on start: SCHED_FIFO, CPU pinning, mlockall and prefaulting.");
+    addProperty("rtPriority", rtPriority).doc("SCHED_FIFO priority of the reading thread, 0 keeps the scheduler of the activity.");
+    addProperty("rtCpu", rtCpu).doc("CPU to pin the reading thread to, -1 keeps the affinity.");
+    addProperty("rtLockMemory", rtLockMemory).doc("Lock all current and future memory of the process.");
+    addProperty("rtPrefaultStack", rtPrefaultStack).doc("Bytes of stack to prefault in the reading thread.");
+    addAttribute("rtHardeningSucceeded", rtHardeningSucceeded);
+    addAttribute("rtMajorFaults", rtMajorFaults);
+
+    addProperty("predictionEnabled", predictionEnabled).doc("Extrapolate the deflection by the age of the frame plus predictionLatency, at most 0.1 s beyond the last frame and not while the device is silent.");
+    addProperty("predictionLatency", predictionLatency).doc("Latency from the output ports to the robot in seconds.");
+    addProperty("predictionAlpha", predictionAlpha).doc("Position gain of the alpha-beta filter.");
+    addProperty("predictionBeta", predictionBeta).doc("Velocity gain of the alpha-beta filter.");
+    addAttribute("predictionRmsTranslation", predictionRmsTranslation);
+    addAttribute("predictionRmsRotation", predictionRmsRotation);
+
+    addProperty("metricsFile", metricsFile).doc("Write the metrics in Prometheus text format to this file (e.g. for the node_exporter textfile collector), empty disables it.");
+    addProperty("metricsPeriod", metricsPeriod).doc("Period of the metrics export in seconds.");
+
+    addProperty("autoCalibration", autoCalibration).doc("Learn bias, noise and range of the axes while running and use an adaptive deadzone instead of sensitivity.");
+    addProperty("calibrationSigma", calibrationSigma).doc("Deadzone in standard deviations of the noise at rest.");
+    addProperty("calibrationPeriod", calibrationPeriod).doc("Period of the calibration updates in seconds.");
+
+    addProperty("connectionCheckInterval", connectionCheckInterval).doc("Outputs are only computed for connected ports, new and removed connections are noticed within this time (s), at the latest with the next frame.");
+
+#ifdef USE_RSTRT
+    addProperty("shapingEnabled", shapingEnabled).doc("Limit velocity, acceleration and jerk of the pose output.");
+    addProperty("shapingPeriod", shapingPeriod).doc("Time in seconds one 6D command increment is spread over, also the wake-up period while shaping.");
+    addProperty("shapingMaxVelocityT", shapingMaxVelocityT).doc("Velocity limit per translation axis (m/s).");
+    addProperty("shapingMaxAccelerationT", shapingMaxAccelerationT).doc("Acceleration limit per translation axis (m/s^2).");
+    addProperty("shapingMaxJerkT", shapingMaxJerkT).doc("Jerk limit per translation axis (m/s^3).");
+    addProperty("shapingMaxVelocityR", shapingMaxVelocityR).doc("Velocity limit per rotation axis (rad/s).");
+    addProperty("shapingMaxAccelerationR", shapingMaxAccelerationR).doc("Acceleration limit per rotation axis (rad/s^2).");
+    addProperty("shapingMaxJerkR", shapingMaxJerkR).doc("Jerk limit per rotation axis (rad/s^3).");
+
+    addProperty("numChannels", numChannels).doc("Number of pose channels driven by the device (1..8), applied on configure.");
+    addProperty("channelWeights", channelWeights).doc("Weight of the increments per channel while blending (default 1).");
+    addProperty("channelEnableMasks", channelEnableMasks).doc("Enabled axes per channel, bit 0..5 = x, y, z, a, b, c (default 63).");
+    addProperty("channelCages", channelCages).doc("Cage per channel as min x, y, z, max x, y, z, a channel with an entry is always caged (default the cage properties while isCageActive).");
+    addProperty("channelBlending", channelBlending).doc("Move all channels by their weight instead of only the selected one.");
+    addProperty("channelSelectButton", channelSelectButton).doc("Button which selects the next channel instead of its translation or orientation toggle, -1 disables it.");
+    addProperty("channelBlendButton", channelBlendButton).doc("Button which toggles channelBlending instead of its translation or orientation toggle, -1 disables it.");
+    addProperty("commandFrame", commandFrame).doc("Frame of the increments: 0 = translation in base, rotation in tool (default), 1 = base, 2 = tool, 3 = reference.");
+#endif
     interface = new SpaceNavHID();
 }
 
-// SpaceNavOrocos::~SpaceNavOrocos() {
-//     if (interface) {
-//         delete interface;
-//     }
-// }
+SpaceNavOrocos::~SpaceNavOrocos()
+{
+    // the exporter and the calibrator use the interface.
+    metricsExporter.stop();
+    calibrator.stop();
+    if (interface)
+    {
+        delete interface;
+    }
+}
 
 bool SpaceNavOrocos::configureHook()
 {
-    if (!interface->initDevice())
+    if (!openInterface())
     {
         RTT::log(RTT::Error) << "[" << this->getName() << "] "
                              << "Unable to access Space Nav at " << getFileDescriptor() << RTT::endlog();
@@ -105,27 +233,63 @@ bool SpaceNavOrocos::configureHook()
     out_6d_port.setDataSample(out_6d_var);
     ports()->addPort(out_6d_port);
 
-#ifdef USE_RSTRT
-    if (this->getPort("out_pose_port"))
+    if (this->getPort("out_command_port"))
     {
-        this->ports()->removePort("out_pose_port");
+        this->ports()->removePort("out_command_port");
     }
-    out_pose_var = rstrt::geometry::Pose();
-    out_pose_port.setName("out_pose_port");
-    out_pose_port.doc("Output port for pose command vector");
-    out_pose_port.setDataSample(out_pose_var);
-    ports()->addPort(out_pose_port);
+    memset(&out_command_var, 0, sizeof out_command_var);
+    out_command_port.setName("out_command_port");
+    out_command_port.doc("Output port for the 6D command as fixed-size type with time stamp, sequence number and buttons (needs the spacenav typekit)");
+    out_command_port.setDataSample(out_command_var);
+    ports()->addPort(out_command_port);
+
+    if (this->getPort("out_button_event_port"))
+    {
+        this->ports()->removePort("out_button_event_port");
+    }
+    out_button_event_var = cosima::hw::SpaceNavButtonEvent();
+    out_button_event_port.setName("out_button_event_port");
+    out_button_event_port.doc("Output port for every button press and release edge, connect with a buffered policy to get all of them");
+    out_button_event_port.setDataSample(out_button_event_var);
+    ports()->addPort(out_button_event_port);
 
-    if (this->getPort("in_current_pose_port"))
+#ifdef USE_RSTRT
+    channels.setCount(numChannels);
+    numChannels = channels.getCount();
+    out_pose_var = rstrt::geometry::Pose();
+    for (int c = 0; c < cosima::hw::SpaceNavChannels::MAX_CHANNELS; c++)
     {
-        this->ports()->removePort("in_current_pose_port");
+        std::ostringstream suffix;
+        if (c > 0)
+        {
+            suffix << "_" << c;
+        }
+        // also drop the ports of channels from a previous configuration.
+        if (this->getPort("out_pose_port" + suffix.str()))
+        {
+            this->ports()->removePort("out_pose_port" + suffix.str());
+        }
+        if (this->getPort("in_current_pose_port" + suffix.str()))
+        {
+            this->ports()->removePort("in_current_pose_port" + suffix.str());
+        }
+        if (c >= numChannels)
+        {
+            continue;
+        }
+
+        out_pose_ports[c].setName("out_pose_port" + suffix.str());
+        out_pose_ports[c].doc("Output port for pose command vector");
+        out_pose_ports[c].setDataSample(out_pose_var);
+        ports()->addPort(out_pose_ports[c]);
+
+        initial_pose_vars[c] = rstrt::geometry::Pose();
+        in_current_pose_ports[c].setName("in_current_pose_port" + suffix.str());
+        in_current_pose_ports[c].doc("Input port for the current pose to which the commands should be added.");
+        ports()->addPort(in_current_pose_ports[c]);
+        in_current_pose_flows[c] = RTT::NoData;
     }
-    in_current_pose_var = rstrt::geometry::Pose();
-    initial_pose_var = rstrt::geometry::Pose();
-    in_current_pose_port.setName("in_current_pose_port");
-    in_current_pose_port.doc("Input port for the current pose to which the commands should be added.");
-    ports()->addPort(in_current_pose_port);
-    in_current_pose_flow = RTT::NoData;
+    channels.clearPoses();
 
     initial_rotation = rstrt::geometry::Rotation();
 #endif
@@ -133,6 +297,30 @@ bool SpaceNavOrocos::configureHook()
     values.reset();
     rawValues.reset();
 
+    if (!metricsFile.empty())
+    {
+        const unsigned int periodMs = metricsPeriod > 0.001 ? (unsigned int)(metricsPeriod * 1000) : 1;
+        if (!metricsExporter.start(&interface->getMetrics(), metricsFile, periodMs, this->getName()))
+        {
+            RTT::log(RTT::Warning) << "[" << this->getName() << "] "
+                                   << "Unable to export metrics to " << metricsFile << RTT::endlog();
+        }
+    }
+
+    interface->clearCalibration();
+    if (autoCalibration)
+    {
+        // the calibrator learns from the history of the raw frames.
+        interface->enableHistory(1000000);
+        calibrator.setDeadzoneSigma(calibrationSigma);
+        const unsigned int periodMs = calibrationPeriod > 0.001 ? (unsigned int)(calibrationPeriod * 1000) : 1;
+        if (!calibrator.start(interface, periodMs))
+        {
+            RTT::log(RTT::Warning) << "[" << this->getName() << "] "
+                                   << "Unable to start the calibration." << RTT::endlog();
+        }
+    }
+
     // indicate proper setup by flashing the led!
     for (uint i = 0; i < 3; i++)
     {
@@ -150,6 +338,11 @@ int SpaceNavOrocos::getFileDescriptor()
     return interface->getFileDescriptor();
 }
 
+bool SpaceNavOrocos::openInterface()
+{
+    return interface->initDevice();
+}
+
 #ifdef USE_RSTRT
 void SpaceNavOrocos::setInitialRotation(rstrt::geometry::Rotation ir)
 {
@@ -160,7 +353,43 @@ void SpaceNavOrocos::setInitialRotation(rstrt::geometry::Rotation ir)
 bool SpaceNavOrocos::startHook()
 {
 #ifdef USE_RSTRT
-    in_current_pose_flow = RTT::NoData;
+    // a limit of 0 freezes the axis, a negative one is a typo.
+    if (!(shapingPeriod > 0 && shapingMaxVelocityT > 0 && shapingMaxAccelerationT > 0 && shapingMaxJerkT > 0 &&
+          shapingMaxVelocityR > 0 && shapingMaxAccelerationR > 0 && shapingMaxJerkR > 0))
+    {
+        RTT::log(RTT::Error) << "[" << this->getName() << "] "
+                             << "shapingPeriod and the shapingMax limits need to be positive." << RTT::endlog();
+        return false;
+    }
+    for (int c = 0; c < numChannels; c++)
+    {
+        in_current_pose_flows[c] = RTT::NoData;
+    }
+    channels.clearPoses();
+    configureChannels();
+#endif
+    refreshConnections();
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    connectionCheckTimestamp = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+    // the hardening needs to run in the reading thread.
+    rtHardeningPending = rtHardening;
+    rtMajorFaults = -1;
+    traceAttachPending = true;
+    predictor.setGains(predictionAlpha, predictionBeta);
+    // scaled values are within +-500.
+    predictor.setLimit(500.0);
+    predictor.reset();
+    predictionLastTimestamp = -1;
+#ifdef USE_RSTRT
+    for (int i = 0; i < 3; i++)
+    {
+        shaper.setLimits(i, shapingMaxVelocityT, shapingMaxAccelerationT, shapingMaxJerkT);
+        shaper.setLimits(i + 3, shapingMaxVelocityR, shapingMaxAccelerationR, shapingMaxJerkR);
+    }
+    shaper.reset();
+    shapingLastUpdate = -1;
+    shapingTimerActive = false;
 #endif
     RTT::extras::FileDescriptorActivity *activity = getActivity<RTT::extras::FileDescriptorActivity>();
     if (activity)
@@ -168,10 +397,10 @@ bool SpaceNavOrocos::startHook()
         activity->watch(getFileDescriptor());
         // get trigger a least every 25 ms
         // activity->setTimeout(25);
-        interface->setLedState(1);
-        return true;
     }
-    return false;
+    // other activities (periodic, slave) poll the non-blocking descriptor on every update.
+    interface->setLedState(1);
+    return true;
 }
 
 // void SpaceNavOrocos::errorHook() {
@@ -186,48 +415,179 @@ int sgn(T val)
 
 void SpaceNavOrocos::updateHook()
 {
+    if (traceAttachPending)
+    {
+        // open, map and clear the ring before the first frame, also ahead of the hardening.
+        traceAttachPending = false;
+#ifdef SPACENAV_TRACING
+        cosima::hw::spacenavTraceAttachThread();
+#endif
+    }
+    if (rtHardeningPending)
+    {
+        rtHardeningPending = false;
+        cosima::hw::SpaceNavRtOptions options;
+        options.priority = rtPriority;
+        options.cpu = rtCpu;
+        options.lockMemory = rtLockMemory;
+        options.prefaultStack = rtPrefaultStack > 0 ? rtPrefaultStack : 0;
+        cosima::hw::SpaceNavRtReport report = interface->hardenCurrentThread(options);
+        rtHardeningSucceeded = report.success();
+        RTT::log(rtHardeningSucceeded ? RTT::Info : RTT::Error) << "[" << this->getName() << "] "
+                                                                << "RT hardening: scheduler " << report.scheduler
+                                                                << ", affinity " << report.affinity
+                                                                << ", mlockall " << report.memoryLocked
+                                                                << ", stack " << report.stackPrefaulted
+                                                                << ", buffers " << report.buffersPrefaulted << RTT::endlog();
+        rtMajorFaults = 0;
+        rtFaultCheckCounter = 0;
+    }
+    else if (rtMajorFaults >= 0 && ++rtFaultCheckCounter >= 1000)
+    {
+        // verify the steady state without a syscall per cycle.
+        rtFaultCheckCounter = 0;
+        const long faults = interface->getMajorFaultsSinceHardening();
+        if (faults > rtMajorFaults)
+        {
+            RTT::log(RTT::Warning) << "[" << this->getName() << "] "
+                                   << faults << " major page faults in the reading thread since hardening." << RTT::endlog();
+        }
+        rtMajorFaults = faults;
+    }
+
     interface->getValue(values, rawValues);
 
-    // adjust sensitivity
-    values.tx = fabs(values.tx) > sensitivity ? values.tx : 0.0;
-    values.ty = fabs(values.ty) > sensitivity ? values.ty : 0.0;
-    values.tz = fabs(values.tz) > sensitivity ? values.tz : 0.0;
-    values.rx = fabs(values.rx) > sensitivity ? values.rx : 0.0;
-    values.ry = fabs(values.ry) > sensitivity ? values.ry : 0.0;
-    values.rz = fabs(values.rz) > sensitivity ? values.rz : 0.0;
+    // one clock read per cycle serves the connection check and the prediction.
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const long long nowUs = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+
+    // pick up new and removed connections without asking the ports every cycle. The clock also
+    // runs while the device rests, so the first frame after a connection is not lost.
+    if (nowUs - connectionCheckTimestamp >= (long long)(connectionCheckInterval * 1e6))
+    {
+        connectionCheckTimestamp = nowUs;
+        refreshConnections();
+    }
+    // the command feeds the 6D, command and pose outputs, skip it if nobody listens.
+#ifdef USE_RSTRT
+    const bool commandNeeded = out6dConnected || commandConnected || poseOutputConnected;
+#else
+    const bool commandNeeded = out6dConnected || commandConnected;
+#endif
+
+    if (commandNeeded && predictionEnabled)
+    {
+        double deflection[6] = {values.tx, values.ty, values.tz, values.rx, values.ry, values.rz};
+        if (rawValues.timestamp != predictionLastTimestamp)
+        {
+            predictionLastTimestamp = rawValues.timestamp;
+            predictor.update(rawValues.timestamp, deflection);
+            const cosima::hw::SpaceNavPredictionStatistics &statistics = predictor.getStatistics();
+            predictionRmsTranslation = sqrt((statistics.rms(0) * statistics.rms(0) + statistics.rms(1) * statistics.rms(1) + statistics.rms(2) * statistics.rms(2)) / 3);
+            predictionRmsRotation = sqrt((statistics.rms(3) * statistics.rms(3) + statistics.rms(4) * statistics.rms(4) + statistics.rms(5) * statistics.rms(5)) / 3);
+        }
+        // frame time stamps are CLOCK_MONOTONIC, the extrapolation covers the age of the frame as well.
+        const long long horizon = (long long)(predictionLatency * 1e6);
+        predictor.predict(nowUs, horizon, deflection);
+        values.tx = deflection[0];
+        values.ty = deflection[1];
+        values.tz = deflection[2];
+        values.rx = deflection[3];
+        values.ry = deflection[4];
+        values.rz = deflection[5];
+        SPACENAV_TRACE(PREDICT_T, values.tx, values.ty, values.tz, horizon);
+        SPACENAV_TRACE(PREDICT_R, values.rx, values.ry, values.rz, horizon);
+    }
 
     // TODO do some scaling!
-    if (values.button1 != button1_old)
+    // every press toggles the mode, even if several edges arrived since the last wake-up.
+    while (interface->popButtonEvent(out_button_event_var))
     {
-        button1_old = values.button1;
-        if (!button1_old)
+        if (buttonEventConnected)
         {
-            RTT::log(RTT::Error) << "[" << this->getName() << "] "
-                                 << "Enabled translation change." << RTT::endlog();
+            out_button_event_port.write(out_button_event_var);
+            interface->getMetrics().add(cosima::hw::SPACENAV_METRIC_PORT_WRITES);
+            SPACENAV_TRACE(PORT_WRITE, 2, out_button_event_var.button, out_button_event_var.pressed, 0);
         }
-        else
+        if (!out_button_event_var.pressed)
         {
-            RTT::log(RTT::Error) << "[" << this->getName() << "] "
-                                 << "Disabled translation change." << RTT::endlog();
+            continue;
         }
-    }
 
-    if (values.button2 != button2_old)
-    {
-        button2_old = values.button2;
-        if (!button2_old)
+#ifdef USE_RSTRT
+        // a button which switches channels does not toggle translation or orientation as well.
+        const bool channelButton = out_button_event_var.button == channelSelectButton || out_button_event_var.button == channelBlendButton;
+#else
+        const bool channelButton = false;
+#endif
+        if (!channelButton && out_button_event_var.button == 0)
         {
-            RTT::log(RTT::Error) << "[" << this->getName() << "] "
-                                 << "Enabled orientation change." << RTT::endlog();
+            button1_old = !button1_old;
+            if (!button1_old)
+            {
+                RTT::log(RTT::Error) << "[" << this->getName() << "] "
+                                     << "Enabled translation change." << RTT::endlog();
+            }
+            else
+            {
+                RTT::log(RTT::Error) << "[" << this->getName() << "] "
+                                     << "Disabled translation change." << RTT::endlog();
+            }
         }
-        else
+        else if (!channelButton && out_button_event_var.button == 1)
+        {
+            button2_old = !button2_old;
+            if (!button2_old)
+            {
+                RTT::log(RTT::Error) << "[" << this->getName() << "] "
+                                     << "Enabled orientation change." << RTT::endlog();
+            }
+            else
+            {
+                RTT::log(RTT::Error) << "[" << this->getName() << "] "
+                                     << "Disabled orientation change." << RTT::endlog();
+            }
+        }
+
+#ifdef USE_RSTRT
+        if (out_button_event_var.button == channelSelectButton)
         {
-            RTT::log(RTT::Error) << "[" << this->getName() << "] "
-                                 << "Disabled orientation change." << RTT::endlog();
+            const int selected = channels.selectNext();
+            RTT::log(RTT::Info) << "[" << this->getName() << "] "
+                                << "Selected channel " << selected << "." << RTT::endlog();
         }
+        if (out_button_event_var.button == channelBlendButton)
+        {
+            channelBlending = !channelBlending;
+            channels.setBlending(channelBlending);
+            RTT::log(RTT::Info) << "[" << this->getName() << "] "
+                                << (channelBlending ? "Blending all channels." : "Moving the selected channel only.") << RTT::endlog();
+        }
+#endif
     }
 
-    if (!values.button1)
+    if (!commandNeeded)
+    {
+        return;
+    }
+
+    // adjust sensitivity, a calibrated interface already removed the deadzone.
+    const int threshold = interface->isCalibrated() ? 0 : sensitivity;
+    interface->getMetrics().add(cosima::hw::SPACENAV_METRIC_THRESHOLD_SUPPRESSED,
+                                (values.tx != 0 && fabs(values.tx) <= threshold) + (values.ty != 0 && fabs(values.ty) <= threshold) +
+                                    (values.tz != 0 && fabs(values.tz) <= threshold) + (values.rx != 0 && fabs(values.rx) <= threshold) +
+                                    (values.ry != 0 && fabs(values.ry) <= threshold) + (values.rz != 0 && fabs(values.rz) <= threshold));
+    values.tx = fabs(values.tx) > threshold ? values.tx : 0.0;
+    values.ty = fabs(values.ty) > threshold ? values.ty : 0.0;
+    values.tz = fabs(values.tz) > threshold ? values.tz : 0.0;
+    values.rx = fabs(values.rx) > threshold ? values.rx : 0.0;
+    values.ry = fabs(values.ry) > threshold ? values.ry : 0.0;
+    values.rz = fabs(values.rz) > threshold ? values.rz : 0.0;
+    SPACENAV_TRACE(THRESHOLD_T, values.tx, values.ty, values.tz, threshold);
+    SPACENAV_TRACE(THRESHOLD_R, values.rx, values.ry, values.rz, threshold);
+
+    if (!button1_old)
     {
         out_6d_var(0) = enableX ? sgn(values.tx) * offsetTranslation : 0.0;
         out_6d_var(1) = enableY ? sgn(values.ty) * offsetTranslation : 0.0;
@@ -240,7 +600,7 @@ void SpaceNavOrocos::updateHook()
         out_6d_var(2) = 0;
     }
 
-    if (!values.button2)
+    if (!button2_old)
     {
         out_6d_var(3) = enableA ? sgn(values.rx) * offsetOrientation : 0.0;
         out_6d_var(4) = enableB ? sgn(values.ry) * offsetOrientation : 0.0;
@@ -252,118 +612,259 @@ void SpaceNavOrocos::updateHook()
         out_6d_var(4) = 0;
         out_6d_var(5) = 0;
     }
+    SPACENAV_TRACE(COMMAND_T, out_6d_var(0), out_6d_var(1), out_6d_var(2), button1_old);
+    SPACENAV_TRACE(COMMAND_R, out_6d_var(3), out_6d_var(4), out_6d_var(5), button2_old);
 
-#ifdef USE_RSTRT
-    if (!in_current_pose_port.connected())
+    if (commandConnected)
+    {
+        out_command_var.timestamp = rawValues.timestamp;
+        out_command_var.sequence++;
+        out_command_var.buttons = rawValues.buttons.bits;
+        for (int i = 0; i < 6; i++)
+        {
+            out_command_var.values[i] = out_6d_var(i);
+        }
+        out_command_port.write(out_command_var);
+        interface->getMetrics().add(cosima::hw::SPACENAV_METRIC_PORT_WRITES);
+        SPACENAV_TRACE(PORT_WRITE, 3, out_command_var.sequence, 0, 0);
+    }
+
+    if (out6dConnected)
     {
-        // if we do not have a pose to add stuff to, we just return the stuff...
         out_6d_port.write(out_6d_var);
+        interface->getMetrics().add(cosima::hw::SPACENAV_METRIC_PORT_WRITES);
+        SPACENAV_TRACE(PORT_WRITE, 0, 0, 0, 0);
     }
-    else
+
+#ifdef USE_RSTRT
+    if (poseOutputConnected)
     {
         // if we do have a pose, we treat our values as new delta!
-        if (in_current_pose_flow == RTT::NoData)
+        if (!acquireChannelPoses())
         {
-            // get the ground truth only once!
-            in_current_pose_flow = in_current_pose_port.read(in_current_pose_var);
-            if (!(initial_rotation.rotation.w() == 0 && initial_rotation.rotation.x() == 0 && initial_rotation.rotation.y() == 0 && initial_rotation.rotation.z() == 0))
-            {
-                in_current_pose_var.rotation = initial_rotation;
-            }
-            initial_pose_var = in_current_pose_var;
             return;
         }
 
-        // Eigen::AngleAxisf rollAngle(out_6d_var(3), Eigen::Vector3f::UnitX());
-        // Eigen::AngleAxisf pitchAngle(out_6d_var(4), Eigen::Vector3f::UnitY());
-        // Eigen::AngleAxisf yawAngle(out_6d_var(5), Eigen::Vector3f::UnitZ());
-
-        Eigen::Quaternionf q = out_pose_var.rotation.euler2Quaternion(out_6d_var(3), out_6d_var(4), out_6d_var(5));
-        // Eigen::Quaternionf q = rollAngle * pitchAngle * yawAngle;
-        // Eigen::Quaternionf q = yawAngle * pitchAngle * rollAngle;
-
-        // Eigen::Quaternionf qBase = Eigen::Quaternionf(in_current_pose_var.rotation.rotation(0), in_current_pose_var.rotation.rotation(1), in_current_pose_var.rotation.rotation(2), in_current_pose_var.rotation.rotation(3));
-        Eigen::Quaternionf qBase;
-        qBase.w() = in_current_pose_var.rotation.rotation(0);
-        qBase.x() = in_current_pose_var.rotation.rotation(1);
-        qBase.y() = in_current_pose_var.rotation.rotation(2);
-        qBase.z() = in_current_pose_var.rotation.rotation(3);
-        q.normalize();
-        qBase.normalize();
-        // RTT::log(RTT::Error)
-        // << "q     = " << q.w() << ", " << q.x() << ", " << q.y() << ", " << q.z() << RTT::endlog();
-        // RTT::log(RTT::Error) << "qBase = " << qBase.w() << ", " << qBase.x() << ", " << qBase.y() << ", " << qBase.z() << RTT::endlog();
-        qBase *= q;
-        // RTT::log(RTT::Error) << "resul = " << qBase.w() << ", " << qBase.x() << ", " << qBase.y() << ", " << qBase.z() << RTT::endlog();
-
-        out_pose_var.translation.translation(0) = in_current_pose_var.translation.translation(0) + out_6d_var(0);
-        out_pose_var.translation.translation(1) = in_current_pose_var.translation.translation(1) + out_6d_var(1);
-        out_pose_var.translation.translation(2) = in_current_pose_var.translation.translation(2) + out_6d_var(2);
-
-        if (isCageActive)
+        // increments of this cycle, shaped if requested.
+        float delta[6] = {out_6d_var(0), out_6d_var(1), out_6d_var(2), out_6d_var(3), out_6d_var(4), out_6d_var(5)};
+        if (shapingEnabled)
         {
-            if (out_pose_var.translation.translation(0) < cageMinX)
-            {
-                out_pose_var.translation.translation(0) = cageMinX;
-            }
-            else if (out_pose_var.translation.translation(0) > cageMaxX)
-            {
-                out_pose_var.translation.translation(0) = cageMaxX;
-            }
+            shapeIncrements(delta);
+        }
+
+        // channels without a cage of their own follow the cage properties, which may change while running.
+        if (isCageActive != appliedCageActive || cageMinX != appliedCage[0] || cageMinY != appliedCage[1] || cageMinZ != appliedCage[2] ||
+            cageMaxX != appliedCage[3] || cageMaxY != appliedCage[4] || cageMaxZ != appliedCage[5])
+        {
+            configureCages();
+        }
+
+        if (commandFrame != channels.getFrame() && commandFrame >= cosima::hw::SPACENAV_FRAME_DEFAULT && commandFrame <= cosima::hw::SPACENAV_FRAME_REFERENCE)
+        {
+            channels.setFrame((cosima::hw::SpaceNavCommandFrame)commandFrame);
+        }
 
-            if (out_pose_var.translation.translation(1) < cageMinY)
+        RstrtEuler euler = {&out_pose_var.rotation};
+        const unsigned int clamped = channels.update(delta, euler);
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            if (!channels.isLive(c) || !poseOutputsConnected[c])
             {
-                out_pose_var.translation.translation(1) = cageMinY;
+                continue;
             }
-            else if (out_pose_var.translation.translation(1) > cageMaxY)
+            float translation[3], rotation[4];
+            channels.getPose(c, translation, rotation);
+            out_pose_var.translation.translation(0) = translation[0];
+            out_pose_var.translation.translation(1) = translation[1];
+            out_pose_var.translation.translation(2) = translation[2];
+            out_pose_var.rotation.rotation(0) = rotation[0];
+            out_pose_var.rotation.rotation(1) = rotation[1];
+            out_pose_var.rotation.rotation(2) = rotation[2];
+            out_pose_var.rotation.rotation(3) = rotation[3];
+            SPACENAV_TRACE(POSE_T, translation[0], translation[1], translation[2], c);
+            if (channels.isCageActive())
             {
-                out_pose_var.translation.translation(1) = cageMaxY;
+                SPACENAV_TRACE(CAGE, translation[0], translation[1], translation[2], (clamped >> c) & 1);
             }
+            SPACENAV_TRACE(POSE_R, rotation[0], rotation[1], rotation[2], rotation[3]);
 
-            if (out_pose_var.translation.translation(2) < cageMinZ)
-            {
-                out_pose_var.translation.translation(2) = cageMinZ;
-            }
-            else if (out_pose_var.translation.translation(2) > cageMaxZ)
+            out_pose_ports[c].write(out_pose_var);
+            interface->getMetrics().add(cosima::hw::SPACENAV_METRIC_PORT_WRITES);
+            SPACENAV_TRACE(PORT_WRITE, 1, c, 0, 0);
+        }
+    }
+#endif
+}
+
+#ifdef USE_RSTRT
+void SpaceNavOrocos::shapeIncrements(float delta[6])
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const long long nowUs = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+    // the first cycle and long pauses do not produce a jump.
+    double dt = shapingLastUpdate < 0 ? 0.0 : (nowUs - shapingLastUpdate) * 1e-6;
+    dt = dt > 0.1 ? 0.1 : dt;
+    shapingLastUpdate = nowUs;
+
+    double target[6], shaped[6];
+    bool idle = true;
+    for (int i = 0; i < 6; i++)
+    {
+        target[i] = delta[i] / shapingPeriod;
+        idle = idle && delta[i] == 0;
+    }
+    shaper.update(target, dt, shaped);
+    for (int i = 0; i < 6; i++)
+    {
+        delta[i] = shaped[i] * dt;
+    }
+
+    // keep waking up while the motion fades out, sleep again once it has settled.
+    const bool needTimer = !(idle && shaper.isSettled());
+    if (needTimer != shapingTimerActive)
+    {
+        RTT::extras::FileDescriptorActivity *activity = getActivity<RTT::extras::FileDescriptorActivity>();
+        if (activity)
+        {
+            activity->setTimeout(needTimer ? (int)ceil(shapingPeriod * 1000) : 0);
+            shapingTimerActive = needTimer;
+        }
+    }
+}
+
+bool SpaceNavOrocos::acquireChannelPoses()
+{
+    bool anyLive = false;
+    for (int c = 0; c < numChannels; c++)
+    {
+        if (in_current_pose_flows[c] == RTT::NoData && poseInputsConnected[c])
+        {
+            // get the ground truth only once!
+            rstrt::geometry::Pose pose;
+            in_current_pose_flows[c] = in_current_pose_ports[c].read(pose);
+            if (in_current_pose_flows[c] != RTT::NoData)
             {
-                out_pose_var.translation.translation(2) = cageMaxZ;
+                if (c == 0 && !(initial_rotation.rotation.w() == 0 && initial_rotation.rotation.x() == 0 && initial_rotation.rotation.y() == 0 && initial_rotation.rotation.z() == 0))
+                {
+                    pose.rotation = initial_rotation;
+                }
+                initial_pose_vars[c] = pose;
+                const float translation[3] = {pose.translation.translation(0), pose.translation.translation(1), pose.translation.translation(2)};
+                const float rotation[4] = {pose.rotation.rotation(0), pose.rotation.rotation(1), pose.rotation.rotation(2), pose.rotation.rotation(3)};
+                channels.setPose(c, translation, rotation);
             }
         }
+        anyLive = anyLive || channels.isLive(c);
+    }
+    return anyLive;
+}
 
-        out_pose_var.rotation.rotation(0) = qBase.w();
-        out_pose_var.rotation.rotation(1) = qBase.x();
-        out_pose_var.rotation.rotation(2) = qBase.y();
-        out_pose_var.rotation.rotation(3) = qBase.z();
+void SpaceNavOrocos::configureChannels()
+{
+    for (int c = 0; c < numChannels; c++)
+    {
+        channels.setWeight(c, c < (int)channelWeights.size() ? channelWeights[c] : 1.0);
+        channels.setEnableMask(c, c < (int)channelEnableMasks.size() ? (unsigned int)channelEnableMasks[c] : cosima::hw::SpaceNavChannels::ALL_AXES);
+    }
+    configureCages();
+    channels.setBlending(channelBlending);
+    channels.select(0);
+    if (commandFrame < cosima::hw::SPACENAV_FRAME_DEFAULT || commandFrame > cosima::hw::SPACENAV_FRAME_REFERENCE)
+    {
+        RTT::log(RTT::Error) << "[" << this->getName() << "] "
+                             << "No command frame " << commandFrame << ", using 0." << RTT::endlog();
+        commandFrame = cosima::hw::SPACENAV_FRAME_DEFAULT;
+    }
+    channels.setFrame((cosima::hw::SpaceNavCommandFrame)commandFrame);
+}
 
-        // out_pose_var.rotation.rotation(0) = 0;
-        // out_pose_var.rotation.rotation(1) = 0;
-        // out_pose_var.rotation.rotation(2) = 1;
-        // out_pose_var.rotation.rotation(3) = 0;
+void SpaceNavOrocos::configureCages()
+{
+    const float cageMin[3] = {cageMinX, cageMinY, cageMinZ};
+    const float cageMax[3] = {cageMaxX, cageMaxY, cageMaxZ};
+    const float openMin[3] = {-INFINITY, -INFINITY, -INFINITY};
+    const float openMax[3] = {INFINITY, INFINITY, INFINITY};
+    bool caged = false;
+    for (int c = 0; c < numChannels; c++)
+    {
+        if ((c + 1) * 6 <= (int)channelCages.size())
+        {
+            const float channelMin[3] = {(float)channelCages[c * 6], (float)channelCages[c * 6 + 1], (float)channelCages[c * 6 + 2]};
+            const float channelMax[3] = {(float)channelCages[c * 6 + 3], (float)channelCages[c * 6 + 4], (float)channelCages[c * 6 + 5]};
+            channels.setCage(c, channelMin, channelMax);
+            caged = true;
+        }
+        else
+        {
+            // an open cage does not clamp.
+            channels.setCage(c, isCageActive ? cageMin : openMin, isCageActive ? cageMax : openMax);
+            caged = caged || isCageActive;
+        }
+    }
+    channels.setCageActive(caged);
 
-        // save state to not return to the initially read pose.
-        in_current_pose_var = out_pose_var;
-        out_pose_port.write(out_pose_var);
+    appliedCageActive = isCageActive;
+    for (int i = 0; i < 3; i++)
+    {
+        appliedCage[i] = cageMin[i];
+        appliedCage[i + 3] = cageMax[i];
     }
-#endif
 }
 
-#ifdef USE_RSTRT
 void SpaceNavOrocos::resetOrientation(float w, float x, float y, float z)
 {
-    out_pose_var.rotation.rotation(0) = w;
-    out_pose_var.rotation.rotation(1) = x;
-    out_pose_var.rotation.rotation(2) = y;
-    out_pose_var.rotation.rotation(3) = z;
+    const float rotation[4] = {w, x, y, z};
+    channels.setRotation(0, rotation);
 }
 
 void SpaceNavOrocos::resetPoseToInitial()
 {
-    in_current_pose_var = initial_pose_var;
+    for (int c = 0; c < numChannels; c++)
+    {
+        if (in_current_pose_flows[c] != RTT::NoData)
+        {
+            resetChannelPose(c, initial_pose_vars[c]);
+        }
+    }
+    shaper.reset();
 }
 
 void SpaceNavOrocos::resetPose(rstrt::geometry::Pose pose)
 {
-    in_current_pose_var = pose;
+    resetChannelPose(0, pose);
+}
+
+void SpaceNavOrocos::resetChannelPose(int channel, rstrt::geometry::Pose pose)
+{
+    if (channel < 0 || channel >= numChannels)
+    {
+        RTT::log(RTT::Error) << "[" << this->getName() << "] "
+                             << "No channel " << channel << "." << RTT::endlog();
+        return;
+    }
+    const float translation[3] = {pose.translation.translation(0), pose.translation.translation(1), pose.translation.translation(2)};
+    const float rotation[4] = {pose.rotation.rotation(0), pose.rotation.rotation(1), pose.rotation.rotation(2), pose.rotation.rotation(3)};
+    channels.setPose(channel, translation, rotation);
+    // do not overwrite it with the current pose of the port.
+    if (in_current_pose_flows[channel] == RTT::NoData)
+    {
+        initial_pose_vars[channel] = pose;
+        in_current_pose_flows[channel] = RTT::NewData;
+    }
+    shaper.reset();
+}
+
+void SpaceNavOrocos::selectChannel(int channel)
+{
+    channels.select(channel);
+}
+
+void SpaceNavOrocos::setCommandReference(rstrt::geometry::Rotation reference)
+{
+    const float rotation[4] = {reference.rotation(0), reference.rotation(1), reference.rotation(2), reference.rotation(3)};
+    channels.setReference(rotation);
 }
 #endif
 
@@ -371,16 +872,25 @@ void SpaceNavOrocos::stopHook()
 {
     RTT::extras::FileDescriptorActivity *activity = getActivity<RTT::extras::FileDescriptorActivity>();
     if (activity)
+    {
         activity->clearAllWatches();
+#ifdef USE_RSTRT
+        if (shapingTimerActive)
+        {
+            activity->setTimeout(0);
+            shapingTimerActive = false;
+        }
+#endif
+    }
     interface->setLedState(0);
 }
 
 void SpaceNavOrocos::cleanupHook()
 {
-    if (interface)
-    {
-        delete interface;
-    }
+    metricsExporter.stop();
+    calibrator.stop();
+    // keep the interface, the component may be configured again.
+    interface->closeDevice();
 }
 
 void SpaceNavOrocos::displayStatus()
@@ -395,7 +905,87 @@ void SpaceNavOrocos::displayStatus()
                          << "enableA = " << enableA << "\n"
                          << "enableB = " << enableB << "\n"
                          << "enableC = " << enableC << "\n"
+                         << "rtHardening = " << rtHardening << " (succeeded " << rtHardeningSucceeded << ", major faults since " << rtMajorFaults << ")\n"
+                         << "predictionEnabled = " << predictionEnabled << " (latency " << predictionLatency << " s)\n"
+                         << "metricsFile = " << metricsFile << " (exporting " << metricsExporter.isRunning() << ")\n"
+                         << "connected outputs: 6d " << out6dConnected << ", command " << commandConnected << ", button events " << buttonEventConnected
+#ifdef USE_RSTRT
+                         << ", pose " << poseOutputConnected
+#endif
+                         << "\n"
+                         << "autoCalibration = " << autoCalibration << " (running " << calibrator.isRunning() << ")\n"
+#ifdef USE_RSTRT
+                         << "shapingEnabled = " << shapingEnabled << " (settled " << shaper.isSettled() << ")\n"
+                         << "numChannels = " << numChannels << " (selected " << channels.getSelected() << ", blending " << channels.isBlending() << ")\n"
+#endif
                          << RTT::endlog();
+
+    cosima::hw::SpaceNavMetricsSnapshot snapshot;
+    interface->getMetrics().snapshot(snapshot);
+    RTT::log(RTT::Error) << "[" << this->getName() << "] Metrics\n";
+    for (int i = 0; i < cosima::hw::SPACENAV_METRIC_COUNT; i++)
+    {
+        const cosima::hw::SpaceNavMetric metric = cosima::hw::SpaceNavMetric(i);
+        RTT::log(RTT::Error) << cosima::hw::SpaceNavMetrics::getName(metric) << "{" << cosima::hw::SpaceNavMetrics::getLabel(metric) << "} = " << snapshot.values[i] << "\n";
+    }
+    RTT::log(RTT::Error) << RTT::endlog();
+    cosima::hw::SpaceNavCalibration calibration;
+    if (interface->getCalibration(calibration))
+    {
+        RTT::log(RTT::Error) << "[" << this->getName() << "] Calibration from " << calibration.samples << " frames at rest (bias / noise / deadzone / range)\n";
+        const char *axes[6] = {"x", "y", "z", "rx", "ry", "rz"};
+        for (int a = 0; a < 6; a++)
+        {
+            const cosima::hw::SpaceNavAxisCalibration &axis = calibration.axes[a];
+            RTT::log(RTT::Error) << axes[a] << " " << axis.bias << " / " << axis.noise << " / " << axis.deadzone << " / [" << axis.minimum << ", " << axis.maximum << "]\n";
+        }
+        RTT::log(RTT::Error) << RTT::endlog();
+    }
+    if (predictionEnabled)
+    {
+        const cosima::hw::SpaceNavPredictionStatistics &statistics = predictor.getStatistics();
+        RTT::log(RTT::Error) << "[" << this->getName() << "] Prediction error over " << statistics.count << " predictions (mean / rms / max)\n";
+        const char *axes[6] = {"tx", "ty", "tz", "rx", "ry", "rz"};
+        for (int a = 0; a < 6; a++)
+        {
+            RTT::log(RTT::Error) << axes[a] << " " << statistics.meanAbs(a) << " / " << statistics.rms(a) << " / " << statistics.maxAbs[a] << "\n";
+        }
+        RTT::log(RTT::Error) << RTT::endlog();
+    }
+}
+
+void SpaceNavOrocos::refreshConnections()
+{
+    out6dConnected = out_6d_port.connected();
+    commandConnected = out_command_port.connected();
+    buttonEventConnected = out_button_event_port.connected();
+#ifdef USE_RSTRT
+    poseOutputConnected = false;
+    for (int c = 0; c < cosima::hw::SpaceNavChannels::MAX_CHANNELS; c++)
+    {
+        poseOutputsConnected[c] = c < numChannels && out_pose_ports[c].connected();
+        poseInputsConnected[c] = c < numChannels && in_current_pose_ports[c].connected();
+        poseOutputConnected = poseOutputConnected || poseOutputsConnected[c];
+    }
+    // nobody listens to the pose anymore, no need to wake up for the shaping.
+    if (!poseOutputConnected && shapingTimerActive)
+    {
+        RTT::extras::FileDescriptorActivity *activity = getActivity<RTT::extras::FileDescriptorActivity>();
+        if (activity)
+        {
+            activity->setTimeout(0);
+        }
+        shapingTimerActive = false;
+        shaper.reset();
+    }
+#endif
+}
+
+void SpaceNavOrocos::resetPredictionStatistics()
+{
+    predictor.resetStatistics();
+    predictionRmsTranslation = 0.0;
+    predictionRmsRotation = 0.0;
 }
 
 ORO_CREATE_COMPONENT_LIBRARY()
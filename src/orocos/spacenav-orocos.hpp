@@ -31,7 +31,12 @@
 #include <rtt/Port.hpp>
 #include <rtt/Component.hpp>
 #include <string>
+#include <vector>
 #include "../spacenav-hid.hpp"
+#include "../spacenav-command.hpp"
+#include "../spacenav-predictor.hpp"
+#include "../spacenav-shaper.hpp"
+#include "../spacenav-channels.hpp"
 #include <Eigen/Dense>
 #include <Eigen/Core>
 
@@ -52,7 +57,7 @@ class SpaceNavOrocos : public RTT::TaskContext
 public:
   SpaceNavOrocos(std::string const &name = "SpaceNavOrocos");
 
-  // ~SpaceNavOrocos();
+  ~SpaceNavOrocos();
 
   bool configureHook();
 
@@ -68,6 +73,13 @@ public:
 
   void displayStatus();
 
+  void resetPredictionStatistics();
+
+  /**
+   * Re-reads the connection state of the output ports.
+   */
+  void refreshConnections();
+
 #ifdef USE_RSTRT
   void resetOrientation(float w, float x, float y, float z);
 
@@ -76,6 +88,15 @@ public:
   void resetPose(rstrt::geometry::Pose pose);
 
   void setInitialRotation(rstrt::geometry::Rotation ir);
+
+  void resetChannelPose(int channel, rstrt::geometry::Pose pose);
+
+  void selectChannel(int channel);
+
+  /**
+   * Rotation of the frame the increments are given in if commandFrame is 3 (reference).
+   */
+  void setCommandReference(rstrt::geometry::Rotation reference);
 #endif
 
 protected:
@@ -83,19 +104,62 @@ protected:
 
   virtual int getFileDescriptor();
 
+  /**
+   * Opens the device on configure, may be overridden to attach another event source
+   * (e.g. a pipe in a benchmark).
+   */
+  virtual bool openInterface();
+
   RTT::OutputPort<Eigen::VectorXf> out_6d_port;
   Eigen::VectorXf out_6d_var;
 
+  /**
+   * Same command as out_6d_port as fixed-size POD with time stamp, sequence and buttons.
+   */
+  RTT::OutputPort<cosima::hw::SpaceNavCommand> out_command_port;
+  cosima::hw::SpaceNavCommand out_command_var;
+
+  RTT::OutputPort<cosima::hw::SpaceNavButtonEvent> out_button_event_port;
+  cosima::hw::SpaceNavButtonEvent out_button_event_var;
+
 #ifdef USE_RSTRT
-  RTT::OutputPort<rstrt::geometry::Pose> out_pose_port;
+  /**
+   * One pose output and current pose input per channel, channel 0 keeps the names
+   * out_pose_port and in_current_pose_port, channel i is suffixed with _i.
+   */
+  RTT::OutputPort<rstrt::geometry::Pose> out_pose_ports[cosima::hw::SpaceNavChannels::MAX_CHANNELS];
   rstrt::geometry::Pose out_pose_var;
 
-  RTT::InputPort<rstrt::geometry::Pose> in_current_pose_port;
-  rstrt::geometry::Pose in_current_pose_var, initial_pose_var;
-  RTT::FlowStatus in_current_pose_flow;
+  RTT::InputPort<rstrt::geometry::Pose> in_current_pose_ports[cosima::hw::SpaceNavChannels::MAX_CHANNELS];
+  rstrt::geometry::Pose initial_pose_vars[cosima::hw::SpaceNavChannels::MAX_CHANNELS];
+  RTT::FlowStatus in_current_pose_flows[cosima::hw::SpaceNavChannels::MAX_CHANNELS];
 #endif
 
 private:
+#ifdef USE_RSTRT
+  /**
+   * Replaces the increments of this cycle by the jerk-limited ones.
+   */
+  void shapeIncrements(float delta[6]);
+
+  /**
+   * Applies the channel properties to the channels.
+   */
+  void configureChannels();
+
+  /**
+   * Applies channelCages and the cage properties to the channels. A channel with an entry in
+   * channelCages is always caged, the others by the cage properties while isCageActive.
+   */
+  void configureCages();
+
+  /**
+   * Reads the current pose of every connected channel that has none yet,
+   * returns true if any channel got its pose in this cycle.
+   */
+  bool acquireChannelPoses();
+#endif
+
   cosima::hw::SpaceNavValues values;
   cosima::hw::SpaceNavValues rawValues;
 
@@ -114,6 +178,126 @@ private:
 
   float cageMinX, cageMinY, cageMinZ, cageMaxX, cageMaxY, cageMaxZ;
   bool isCageActive;
+
+  /**
+   * RT hardening of the reading thread (SCHED_FIFO, affinity, mlockall, prefault),
+   * applied on the first update after start.
+   */
+  bool rtHardening;
+  int rtPriority;
+  int rtCpu;
+  bool rtLockMemory;
+  int rtPrefaultStack;
+  bool rtHardeningPending;
+  bool rtHardeningSucceeded;
+  /**
+   * Major page faults of the reading thread since hardening, sampled every rtFaultCheckCycles updates.
+   */
+  int rtMajorFaults;
+  unsigned int rtFaultCheckCounter;
+  /**
+   * With SPACENAV_TRACING, the trace ring of the reading thread is mapped on the first update
+   * after start instead of at the first trace point of a frame.
+   */
+  bool traceAttachPending;
+
+  /**
+   * Extrapolates the deflection to compensate the latency to the robot.
+   * The age of a frame is known from its time stamp, predictionLatency (s) adds the downstream part.
+   */
+  bool predictionEnabled;
+  double predictionLatency;
+  double predictionAlpha;
+  double predictionBeta;
+  /**
+   * RMS prediction error of the translation and rotation axes, in scaled device units.
+   */
+  double predictionRmsTranslation;
+  double predictionRmsRotation;
+  cosima::hw::SpaceNavPredictor predictor;
+  long long predictionLastTimestamp;
+
+  /**
+   * Prometheus text file with the metrics of the interface (empty disables the export)
+   * and the period of the export in seconds.
+   */
+  std::string metricsFile;
+  double metricsPeriod;
+  cosima::hw::SpaceNavMetricsExporter metricsExporter;
+
+  /**
+   * Estimates bias, noise and range of the axes in the background (every calibrationPeriod
+   * seconds) and replaces the fixed sensitivity threshold by a deadzone of calibrationSigma
+   * standard deviations of the noise at rest.
+   */
+  bool autoCalibration;
+  double calibrationSigma;
+  double calibrationPeriod;
+  cosima::hw::SpaceNavCalibrator calibrator;
+
+  /**
+   * Connection state of the ports, cached so that updateHook does not ask the ports every cycle.
+   * It is refreshed on start, by refreshConnections and on the first update after
+   * connectionCheckInterval seconds (CLOCK_MONOTONIC, also while the device rests).
+   * Each output is only computed and written if connected.
+   */
+  double connectionCheckInterval;
+  long long connectionCheckTimestamp;
+  bool out6dConnected;
+  bool commandConnected;
+  bool buttonEventConnected;
+
+#ifdef USE_RSTRT
+  /**
+   * Jerk-limited shaping of the pose increments. The 6D command is read as increment per
+   * shapingPeriod; while the shaper has not settled the activity also wakes up every
+   * shapingPeriod, so that the pose comes to rest smoothly after the last event.
+   */
+  bool shapingEnabled;
+  double shapingPeriod;
+  double shapingMaxVelocityT, shapingMaxAccelerationT, shapingMaxJerkT;
+  double shapingMaxVelocityR, shapingMaxAccelerationR, shapingMaxJerkR;
+  cosima::hw::SpaceNavShaper shaper;
+  long long shapingLastUpdate;
+  bool shapingTimerActive;
+
+  /**
+   * Several pose channels driven by the device. The number of channels is fixed on configure,
+   * weights, enable masks (bit 0..5 = x, y, z, a, b, c) and cages (min x, y, z, max x, y, z)
+   * are given per channel; missing entries fall back to 1, all axes and the cage properties
+   * (only while isCageActive, a channel with a cage entry of its own is always caged).
+   * A press of channelSelectButton selects the next channel, a press of channelBlendButton
+   * toggles between moving all channels by their weight and only the selected one (-1 disables).
+   * Buttons 0 and 1 only toggle translation and orientation if they are not assigned to either.
+   */
+  int numChannels;
+  std::vector<double> channelWeights;
+  std::vector<int> channelEnableMasks;
+  std::vector<double> channelCages;
+  bool channelBlending;
+  int channelSelectButton;
+  int channelBlendButton;
+  /**
+   * Cage properties last applied by configureCages(), to notice changes while running.
+   */
+  bool appliedCageActive;
+  float appliedCage[6];
+
+  /**
+   * Frame the increments are applied in: 0 = translation along the base, rotation about the
+   * tool axes (as before), 1 = base, 2 = tool of each channel, 3 = setCommandReference.
+   * May be switched while running.
+   */
+  int commandFrame;
+  cosima::hw::SpaceNavChannels channels;
+
+  /**
+   * Cached connection state of the pose ports, see connectionCheckInterval.
+   */
+  bool poseOutputConnected;
+  bool poseOutputsConnected[cosima::hw::SpaceNavChannels::MAX_CHANNELS];
+  bool poseInputsConnected[cosima::hw::SpaceNavChannels::MAX_CHANNELS];
+#endif
 };
 
 } // namespace hw
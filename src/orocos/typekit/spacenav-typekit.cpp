@@ -0,0 +1,103 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "../../spacenav-command.hpp"
+#include "../../spacenav-hid.hpp"
+#include <boost/serialization/serialization.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/array.hpp>
+#include <vector>
+
+namespace boost
+{
+namespace serialization
+{
+
+// decomposition of the command into its parts for RTT (scripting, reporting, transports).
+template <class Archive>
+void serialize(Archive &a, cosima::hw::SpaceNavCommand &command, unsigned int)
+{
+    a &make_nvp("timestamp", command.timestamp);
+    a &make_nvp("sequence", command.sequence);
+    a &make_nvp("buttons", command.buttons);
+    a &make_nvp("values", make_array(command.values, 6));
+}
+
+// a press or release edge of out_button_event_port.
+template <class Archive>
+void serialize(Archive &a, cosima::hw::SpaceNavButtonEvent &event, unsigned int)
+{
+    a &make_nvp("timestamp", event.timestamp);
+    a &make_nvp("button", event.button);
+    a &make_nvp("pressed", event.pressed);
+}
+
+} // namespace serialization
+} // namespace boost
+
+// after the decomposition, the type infos look it up at their definition.
+#include <rtt/types/TypekitPlugin.hpp>
+#include <rtt/types/StructTypeInfo.hpp>
+#include <rtt/types/SequenceTypeInfo.hpp>
+
+namespace cosima
+{
+namespace hw
+{
+
+class SpaceNavTypekitPlugin : public RTT::types::TypekitPlugin
+{
+public:
+    bool loadTypes()
+    {
+        RTT::types::Types()->addType(new RTT::types::StructTypeInfo<cosima::hw::SpaceNavCommand>("/cosima/hw/SpaceNavCommand"));
+        RTT::types::Types()->addType(new RTT::types::SequenceTypeInfo<std::vector<cosima::hw::SpaceNavCommand> >("/cosima/hw/SpaceNavCommand[]"));
+        RTT::types::Types()->addType(new RTT::types::StructTypeInfo<cosima::hw::SpaceNavButtonEvent>("/cosima/hw/SpaceNavButtonEvent"));
+        RTT::types::Types()->addType(new RTT::types::SequenceTypeInfo<std::vector<cosima::hw::SpaceNavButtonEvent> >("/cosima/hw/SpaceNavButtonEvent[]"));
+        return true;
+    }
+
+    bool loadConstructors()
+    {
+        return true;
+    }
+
+    bool loadOperators()
+    {
+        return true;
+    }
+
+    std::string getName()
+    {
+        return "spacenav-typekit";
+    }
+};
+
+} // namespace hw
+} // namespace cosima
+
+ORO_TYPEKIT_PLUGIN(cosima::hw::SpaceNavTypekitPlugin)
@@ -0,0 +1,328 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "spacenav-calibration.hpp"
+#include "spacenav-hid.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+SpaceNavCalibrator::SpaceNavCalibrator() : deadzoneSigma(4.0),
+                                           hid(NULL),
+                                           periodMs(1000),
+                                           running(false)
+{
+  for (int i = 0; i < 6; i++)
+  {
+    nominalMinimum[i] = -500;
+    nominalMaximum[i] = 500;
+  }
+  reset();
+}
+
+SpaceNavCalibrator::~SpaceNavCalibrator()
+{
+  stop();
+}
+
+void SpaceNavCalibrator::setDeadzoneSigma(const double sigma)
+{
+  deadzoneSigma = sigma > 0 ? sigma : 0;
+}
+
+void SpaceNavCalibrator::setMemory(const unsigned int frames)
+{
+  for (int i = 0; i < 6; i++)
+  {
+    statistics[i].setMemory(frames);
+  }
+}
+
+void SpaceNavCalibrator::setRange(const int axis, const double minimum, const double maximum)
+{
+  if (axis < 0 || axis >= 6 || maximum <= minimum)
+  {
+    return;
+  }
+  nominalMinimum[axis] = minimum;
+  nominalMaximum[axis] = maximum;
+}
+
+void SpaceNavCalibrator::reset()
+{
+  for (int i = 0; i < 6; i++)
+  {
+    statistics[i].reset();
+    observedMinimum[i] = 0;
+    observedMaximum[i] = 0;
+    seeds[i] = 0;
+  }
+  seeded = false;
+  settled = false;
+  missed = 0;
+  restSince = 0;
+  inRun = false;
+  runStart = 0;
+  runCommit = 0;
+  next = 0;
+}
+
+double SpaceNavCalibrator::getRestBand(const int axis) const
+{
+  const double halfRange = (nominalMaximum[axis] - nominalMinimum[axis]) / 2;
+  const double widest = 0.1 * halfRange;
+  if (!settled)
+  {
+    return widest;
+  }
+  // the rest band is wider than the deadzone, to keep learning while the noise grows.
+  const double narrowest = 0.01 * halfRange > 2 ? 0.01 * halfRange : 2;
+  const double band = 2 * deadzoneSigma * sqrt(statistics[axis].getVariance());
+  return band < narrowest ? narrowest : (band > widest ? widest : band);
+}
+
+void SpaceNavCalibrator::commit(const SpaceNavHistorySample &sample)
+{
+  for (int i = 0; i < 6; i++)
+  {
+    statistics[i].push(sample.axes[i]);
+  }
+  if (!settled)
+  {
+    restSince = statistics[0].getCount() == 1 ? sample.timestamp : restSince;
+    settled = statistics[0].getCount() >= MIN_SAMPLES && sample.timestamp - restSince >= SETTLE_US;
+  }
+}
+
+double SpaceNavCalibrator::getRestCenter(const int axis) const
+{
+  return settled ? statistics[axis].getMean() : seeds[axis];
+}
+
+bool SpaceNavCalibrator::seed(const SpaceNavHistory &history, const unsigned long long count)
+{
+  std::vector<int> values[6];
+  SpaceNavHistorySample sample;
+  for (unsigned long long sequence = next; sequence < count && values[0].size() < SEED_FRAMES; sequence++)
+  {
+    if (history.get(sequence, sample))
+    {
+      for (int i = 0; i < 6; i++)
+      {
+        values[i].push_back(sample.axes[i]);
+      }
+    }
+  }
+  if (values[0].size() < SEED_FRAMES)
+  {
+    return false;
+  }
+  // the median ignores the frames in which the device was moved, as long as it rests most of the time.
+  for (int i = 0; i < 6; i++)
+  {
+    std::nth_element(values[i].begin(), values[i].begin() + SEED_FRAMES / 2, values[i].end());
+    seeds[i] = values[i][SEED_FRAMES / 2];
+  }
+  seeded = true;
+  missed = 0;
+  return true;
+}
+
+bool SpaceNavCalibrator::update(const SpaceNavHistory &history)
+{
+  const unsigned long long count = history.getCount();
+  // frames which are already overwritten are skipped.
+  if (count - next > SpaceNavHistory::CAPACITY)
+  {
+    next = count - SpaceNavHistory::CAPACITY;
+    inRun = false;
+  }
+  const unsigned long long first = next;
+
+  SpaceNavHistorySample sample;
+  for (; next < count; next++)
+  {
+    // the seed looks ahead, with too few frames left they wait for the next update.
+    if (!seeded && !seed(history, count))
+    {
+      break;
+    }
+    if (!history.get(next, sample))
+    {
+      continue;
+    }
+    bool rest = true;
+    for (int i = 0; i < 6; i++)
+    {
+      observedMinimum[i] = sample.axes[i] < observedMinimum[i] ? sample.axes[i] : observedMinimum[i];
+      observedMaximum[i] = sample.axes[i] > observedMaximum[i] ? sample.axes[i] : observedMaximum[i];
+      rest = rest && fabs(sample.axes[i] - getRestCenter(i)) <= getRestBand(i);
+    }
+    if (rest)
+    {
+      missed = 0;
+      if (!inRun)
+      {
+        inRun = true;
+        runStart = sample.timestamp;
+        runCommit = next;
+      }
+      // frames of the run are used once they are GUARD_US away from both of its ends.
+      SpaceNavHistorySample earlier;
+      for (; runCommit <= next; runCommit++)
+      {
+        if (!history.get(runCommit, earlier))
+        {
+          continue;
+        }
+        if (earlier.timestamp > sample.timestamp - GUARD_US)
+        {
+          break;
+        }
+        if (earlier.timestamp >= runStart + GUARD_US)
+        {
+          commit(earlier);
+        }
+      }
+    }
+    else
+    {
+      // the frames of the run not used yet belong to the flank of the motion.
+      inRun = false;
+      if (!settled)
+      {
+        // the device has to rest without interruption, passing through the band is motion.
+        for (int i = 0; i < 6; i++)
+        {
+          statistics[i].reset();
+        }
+        // the seed was taken while the device moved, take it again from the following frames.
+        seeded = ++missed < RESEED_FRAMES;
+      }
+    }
+  }
+  return next > first;
+}
+
+bool SpaceNavCalibrator::getCalibration(SpaceNavCalibration &calibration) const
+{
+  if (!settled)
+  {
+    return false;
+  }
+  for (int i = 0; i < 6; i++)
+  {
+    SpaceNavAxisCalibration &axis = calibration.axes[i];
+    axis.bias = statistics[i].getMean();
+    axis.noise = sqrt(statistics[i].getVariance());
+    // at least one count, the raw values are integers.
+    axis.deadzone = deadzoneSigma * axis.noise > 1 ? deadzoneSigma * axis.noise : 1;
+    axis.minimum = observedMinimum[i] < nominalMinimum[i] ? observedMinimum[i] : nominalMinimum[i];
+    axis.maximum = observedMaximum[i] > nominalMaximum[i] ? observedMaximum[i] : nominalMaximum[i];
+  }
+  calibration.samples = statistics[0].getCount();
+  return true;
+}
+
+bool SpaceNavCalibrator::start(SpaceNavHID *h, const unsigned int period)
+{
+  stop();
+  if (!h || !h->getHistory() || period == 0)
+  {
+    return false;
+  }
+  for (int i = 0; i < 6; i++)
+  {
+    int minimum, maximum;
+    if (h->getAxisRange(i, minimum, maximum))
+    {
+      setRange(i, minimum, maximum);
+    }
+  }
+  reset();
+  hid = h;
+  periodMs = period;
+  running = true;
+  thread = std::thread(&SpaceNavCalibrator::run, this);
+  return true;
+}
+
+void SpaceNavCalibrator::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running)
+    {
+      return;
+    }
+    running = false;
+  }
+  wakeup.notify_all();
+  thread.join();
+}
+
+bool SpaceNavCalibrator::isRunning()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return running;
+}
+
+void SpaceNavCalibrator::run()
+{
+  SpaceNavCalibration calibration;
+  bool published = false;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (running)
+  {
+    lock.unlock();
+    if (update(*hid->getHistory()) && getCalibration(calibration))
+    {
+      hid->setCalibration(calibration);
+      if (!published)
+      {
+        std::cout << "[SpaceNavHID] "
+                  << "Calibrated from " << calibration.samples << " frames at rest." << std::endl;
+      }
+      published = true;
+    }
+    lock.lock();
+    wakeup.wait_for(lock, std::chrono::milliseconds(periodMs));
+  }
+}
+
+}; // namespace hw
+
+}; // namespace cosima
@@ -0,0 +1,272 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#ifndef _COSIMA_SpaceNavCalibration_H_
+#define _COSIMA_SpaceNavCalibration_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "spacenav-history.hpp"
+
+namespace cosima
+{
+
+namespace hw
+{
+
+class SpaceNavHID;
+
+/**
+ * Calibration of one raw device axis.
+ */
+struct SpaceNavAxisCalibration
+{
+  /**
+   * Raw value at rest and standard deviation of the raw value at rest.
+   */
+  double bias;
+  double noise;
+  /**
+   * Raw distance from the bias which is still considered as rest.
+   */
+  double deadzone;
+  /**
+   * Raw range, the nominal one of the device widened by the observed extremes.
+   */
+  double minimum;
+  double maximum;
+};
+
+/**
+ * Calibration of the six raw device axes (0 = ABS_X ... 5 = ABS_RZ).
+ */
+struct SpaceNavCalibration
+{
+  SpaceNavAxisCalibration axes[6];
+  /**
+   * Number of rest frames the estimate is based on.
+   */
+  unsigned long long samples;
+};
+
+/**
+ * Running mean and variance in constant memory (Welford). After memory samples the
+ * weight of new samples stays at 1 / memory, i.e. older samples are forgotten exponentially
+ * and the estimate follows a slowly drifting device.
+ */
+class SpaceNavRunningStatistics
+{
+public:
+  explicit SpaceNavRunningStatistics(const unsigned long long memory = 2000) : memory(memory)
+  {
+    reset();
+  }
+
+  void setMemory(const unsigned long long m)
+  {
+    memory = m < 1 ? 1 : m;
+  }
+
+  void reset()
+  {
+    count = 0;
+    mean = 0;
+    variance = 0;
+  }
+
+  void push(const double x)
+  {
+    count++;
+    const double weight = 1.0 / (count < memory ? count : memory);
+    const double delta = x - mean;
+    mean += weight * delta;
+    variance = (1 - weight) * (variance + weight * delta * delta);
+  }
+
+  unsigned long long getCount() const
+  {
+    return count;
+  }
+
+  double getMean() const
+  {
+    return mean;
+  }
+
+  double getVariance() const
+  {
+    return variance;
+  }
+
+private:
+  unsigned long long memory;
+  unsigned long long count;
+  double mean;
+  double variance;
+};
+
+/**
+ * Estimates the rest bias, noise and range of the raw axes from the history of an interface
+ * and hands the result to its scaling stage.
+ *
+ * A frame counts as rest if every axis is within a band around its bias, the band follows
+ * the noise (limited to 1 % ... 10 % of the half range). The band starts around the median of
+ * the first SEED_FRAMES frames, so a worn device with a bias beyond the band still calibrates,
+ * and only follows the running mean once the device rested in it without interruption for
+ * MIN_SAMPLES frames and SETTLE_US, so slow motion is not taken for rest. Before that, the
+ * seed is taken again from the following frames if RESEED_FRAMES frames in a row miss the
+ * band. Only rest frames at least GUARD_US away from motion are used. The deadzone is
+ * deadzoneSigma standard deviations of the noise. All work happens in a background thread
+ * which reads the history, the reading thread only picks up the published calibration.
+ */
+class SpaceNavCalibrator
+{
+public:
+  /**
+   * Rest frames needed before a calibration is published.
+   */
+  static const unsigned int MIN_SAMPLES = 50;
+
+  /**
+   * Time the device needs to rest around the seed before a calibration is published.
+   */
+  static const long long SETTLE_US = 500000;
+
+  /**
+   * Rest frames closer than this to a frame outside the band are not used: they belong to
+   * the flanks of a push, which pass through the band.
+   */
+  static const long long GUARD_US = 50000;
+
+  /**
+   * Frames the initial bias (median) is taken from.
+   */
+  static const unsigned int SEED_FRAMES = 32;
+
+  /**
+   * Frames in a row outside the band after which the seed is taken again, as long as
+   * no calibration was published.
+   */
+  static const unsigned int RESEED_FRAMES = 128;
+
+  SpaceNavCalibrator();
+
+  ~SpaceNavCalibrator();
+
+  void setDeadzoneSigma(const double sigma);
+
+  /**
+   * Number of rest frames after which older ones are forgotten.
+   */
+  void setMemory(const unsigned int frames);
+
+  /**
+   * Nominal raw range of an axis, the default is -500 ... 500.
+   */
+  void setRange(const int axis, const double minimum, const double maximum);
+
+  void reset();
+
+  /**
+   * Consumes the frames pushed to the history since the last call.
+   * Returns true if there were new frames. Not thread-safe, use either this or start().
+   */
+  bool update(const SpaceNavHistory &history);
+
+  /**
+   * Current estimate, false until the device rested for MIN_SAMPLES frames and SETTLE_US in a row.
+   */
+  bool getCalibration(SpaceNavCalibration &calibration) const;
+
+  /**
+   * Takes the ranges from the interface and calibrates it every periodMs in a background thread.
+   * The history of the interface needs to be enabled. The interface needs to outlive the
+   * calibrator (or stop()).
+   */
+  bool start(SpaceNavHID *hid, const unsigned int periodMs);
+
+  void stop();
+
+  bool isRunning();
+
+private:
+  void run();
+
+  double getRestBand(const int axis) const;
+
+  /**
+   * Center of the rest band: the seed until the first calibration, the running mean afterwards.
+   */
+  double getRestCenter(const int axis) const;
+
+  /**
+   * Adds a rest frame to the statistics.
+   */
+  void commit(const SpaceNavHistorySample &sample);
+
+  /**
+   * Takes the median of the next SEED_FRAMES frames of the history as seed, without
+   * consuming them. Returns false if there are not enough frames yet.
+   */
+  bool seed(const SpaceNavHistory &history, const unsigned long long count);
+
+  double deadzoneSigma;
+  SpaceNavRunningStatistics statistics[6];
+  double nominalMinimum[6];
+  double nominalMaximum[6];
+  double observedMinimum[6];
+  double observedMaximum[6];
+  double seeds[6];
+  bool seeded;
+  bool settled;
+  /**
+   * Frames in a row outside the rest band and time stamp of the first rest frame, until settled.
+   */
+  unsigned long long missed;
+  long long restSince;
+  /**
+   * Current run of rest frames: time stamp of its first frame and the next frame to commit.
+   */
+  bool inRun;
+  long long runStart;
+  unsigned long long runCommit;
+  unsigned long long next;
+
+  SpaceNavHID *hid;
+  unsigned int periodMs;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  bool running;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
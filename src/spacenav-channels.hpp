@@ -0,0 +1,545 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavChannels_H_
+#define _COSIMA_SpaceNavChannels_H_
+
+#include <math.h>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Frame the increments are given in.
+ */
+enum SpaceNavCommandFrame
+{
+  SPACENAV_FRAME_DEFAULT = 0,  // translation along the base axes, rotation about the tool axes
+  SPACENAV_FRAME_BASE = 1,     // translation along and rotation about the base axes
+  SPACENAV_FRAME_TOOL = 2,     // translation along and rotation about the tool axes of each channel
+  SPACENAV_FRAME_REFERENCE = 3 // translation along and rotation about the axes of a reference rotation
+};
+
+/**
+ * Several poses (channels) driven by the same 6D increments, e.g. two arms or an arm
+ * and a camera.
+ *
+ * Every channel has its own pose, cage and enable mask. Either all channels move together,
+ * each with its weight (blending), or only the selected one. The state is kept as one array
+ * per component, so that update() runs the translation and the cage over all channels in
+ * straight loops; the per-channel gains are only recomputed when the configuration changes.
+ * In the tool frame the rotation matrix of every channel is cached next to its quaternion,
+ * written while the new quaternion is still at hand, so moving along the tool costs one 3x3
+ * product per channel. Rebuilding it from the unit quaternion is cheaper than multiplying it
+ * by the increment and cannot drift.
+ */
+class SpaceNavChannels
+{
+public:
+  static const int MAX_CHANNELS = 8;
+
+  /**
+   * Bits of the enable mask, one per axis of the increments.
+   */
+  static const unsigned int ALL_AXES = 0x3f;
+
+  SpaceNavChannels() : count(1), selected(0), blending(true), cageActive(false), frame(SPACENAV_FRAME_DEFAULT)
+  {
+    const float identity[4] = {1, 0, 0, 0};
+    setReference(identity);
+    for (int c = 0; c < MAX_CHANNELS; c++)
+    {
+      tx[c] = ty[c] = tz[c] = 0;
+      qw[c] = 1;
+      qx[c] = qy[c] = qz[c] = 0;
+      cageMinX[c] = cageMinY[c] = cageMinZ[c] = -INFINITY;
+      cageMaxX[c] = cageMaxY[c] = cageMaxZ[c] = INFINITY;
+      enableMask[c] = ALL_AXES;
+      weight[c] = 1;
+      live[c] = false;
+    }
+    refresh();
+    resync();
+  }
+
+  void setCount(const int n)
+  {
+    count = n < 1 ? 1 : (n > MAX_CHANNELS ? MAX_CHANNELS : n);
+    selected = selected < count ? selected : 0;
+    refresh();
+  }
+
+  int getCount() const
+  {
+    return count;
+  }
+
+  /**
+   * Sets the pose of a channel (quaternion w, x, y, z) and lets it follow the increments.
+   */
+  void setPose(const int c, const float translation[3], const float rotation[4])
+  {
+    tx[c] = translation[0];
+    ty[c] = translation[1];
+    tz[c] = translation[2];
+    qw[c] = rotation[0];
+    qx[c] = rotation[1];
+    qy[c] = rotation[2];
+    qz[c] = rotation[3];
+    live[c] = true;
+    refresh();
+    resyncChannel(c);
+  }
+
+  void setRotation(const int c, const float rotation[4])
+  {
+    qw[c] = rotation[0];
+    qx[c] = rotation[1];
+    qy[c] = rotation[2];
+    qz[c] = rotation[3];
+    resyncChannel(c);
+  }
+
+  void getPose(const int c, float translation[3], float rotation[4]) const
+  {
+    translation[0] = tx[c];
+    translation[1] = ty[c];
+    translation[2] = tz[c];
+    rotation[0] = qw[c];
+    rotation[1] = qx[c];
+    rotation[2] = qy[c];
+    rotation[3] = qz[c];
+  }
+
+  /**
+   * A channel without a pose does not move until setPose() is called.
+   */
+  bool isLive(const int c) const
+  {
+    return live[c];
+  }
+
+  void clearPoses()
+  {
+    for (int c = 0; c < MAX_CHANNELS; c++)
+    {
+      live[c] = false;
+    }
+    refresh();
+  }
+
+  void setCage(const int c, const float min[3], const float max[3])
+  {
+    cageMinX[c] = min[0];
+    cageMinY[c] = min[1];
+    cageMinZ[c] = min[2];
+    cageMaxX[c] = max[0];
+    cageMaxY[c] = max[1];
+    cageMaxZ[c] = max[2];
+  }
+
+  /**
+   * Turns the clamping on or off for all channels, channels with an open cage
+   * (infinite bounds, the default) are not clamped either way.
+   */
+  void setCageActive(const bool active)
+  {
+    cageActive = active;
+  }
+
+  bool isCageActive() const
+  {
+    return cageActive;
+  }
+
+  void setEnableMask(const int c, const unsigned int mask)
+  {
+    enableMask[c] = mask & ALL_AXES;
+    refresh();
+  }
+
+  unsigned int getEnableMask(const int c) const
+  {
+    return enableMask[c];
+  }
+
+  void setWeight(const int c, const float w)
+  {
+    weight[c] = w;
+    refresh();
+  }
+
+  /**
+   * Moves all channels by their weight (true) or only the selected channel (false).
+   */
+  void setBlending(const bool enable)
+  {
+    blending = enable;
+    refresh();
+  }
+
+  bool isBlending() const
+  {
+    return blending;
+  }
+
+  void select(const int c)
+  {
+    selected = c >= 0 && c < count ? c : 0;
+    refresh();
+  }
+
+  int getSelected() const
+  {
+    return selected;
+  }
+
+  /**
+   * Selects the next channel, wrapping around.
+   */
+  int selectNext()
+  {
+    select((selected + 1) % count);
+    return selected;
+  }
+
+  void setFrame(const SpaceNavCommandFrame f)
+  {
+    frame = f;
+    // the matrices are only kept up to date while they are used.
+    resync();
+  }
+
+  SpaceNavCommandFrame getFrame() const
+  {
+    return frame;
+  }
+
+  /**
+   * Rotation (w, x, y, z) of the reference frame, relative to the base.
+   */
+  void setReference(const float rotation[4])
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      reference[i] = rotation[i];
+    }
+    normalize(reference);
+    toMatrix(reference, referenceMatrix);
+  }
+
+  /**
+   * Rotation matrix (row-major) of a channel, cached while in the tool frame.
+   */
+  void getMatrix(const int c, float matrix[9]) const
+  {
+    matrix[0] = r00[c];
+    matrix[1] = r01[c];
+    matrix[2] = r02[c];
+    matrix[3] = r10[c];
+    matrix[4] = r11[c];
+    matrix[5] = r12[c];
+    matrix[6] = r20[c];
+    matrix[7] = r21[c];
+    matrix[8] = r22[c];
+  }
+
+  /**
+   * True if the channel is moved by the increments in the current configuration.
+   */
+  bool isActive(const int c) const
+  {
+    return rotationMode[c] != ROTATION_NONE || gainX[c] != 0 || gainY[c] != 0 || gainZ[c] != 0;
+  }
+
+  /**
+   * Adds the increments (x, y, z, a, b, c) to all active channels and returns a bit per
+   * channel that was clamped by its cage.
+   *
+   * euler(a, b, c, q) converts euler increments to a quaternion (w, x, y, z). It is called
+   * once for the full increments and only once more per channel whose rotation gains are
+   * neither all zero nor all one.
+   */
+  template <typename Euler>
+  unsigned int update(const float delta[6], Euler &euler)
+  {
+    if (frame == SPACENAV_FRAME_TOOL)
+    {
+      // the orientation before this increment.
+      for (int c = 0; c < count; c++)
+      {
+        const float x = gainX[c] * delta[0], y = gainY[c] * delta[1], z = gainZ[c] * delta[2];
+        tx[c] += r00[c] * x + r01[c] * y + r02[c] * z;
+        ty[c] += r10[c] * x + r11[c] * y + r12[c] * z;
+        tz[c] += r20[c] * x + r21[c] * y + r22[c] * z;
+      }
+    }
+    else if (frame == SPACENAV_FRAME_REFERENCE)
+    {
+      const float *f = referenceMatrix;
+      for (int c = 0; c < count; c++)
+      {
+        const float x = gainX[c] * delta[0], y = gainY[c] * delta[1], z = gainZ[c] * delta[2];
+        tx[c] += f[0] * x + f[1] * y + f[2] * z;
+        ty[c] += f[3] * x + f[4] * y + f[5] * z;
+        tz[c] += f[6] * x + f[7] * y + f[8] * z;
+      }
+    }
+    else
+    {
+      for (int c = 0; c < count; c++)
+      {
+        tx[c] += gainX[c] * delta[0];
+        ty[c] += gainY[c] * delta[1];
+        tz[c] += gainZ[c] * delta[2];
+      }
+    }
+
+    unsigned int clamped = 0;
+    if (cageActive)
+    {
+      for (int c = 0; c < count; c++)
+      {
+        const float x = tx[c] < cageMinX[c] ? cageMinX[c] : (tx[c] > cageMaxX[c] ? cageMaxX[c] : tx[c]);
+        const float y = ty[c] < cageMinY[c] ? cageMinY[c] : (ty[c] > cageMaxY[c] ? cageMaxY[c] : ty[c]);
+        const float z = tz[c] < cageMinZ[c] ? cageMinZ[c] : (tz[c] > cageMaxZ[c] ? cageMaxZ[c] : tz[c]);
+        clamped |= (unsigned int)(x != tx[c] || y != ty[c] || z != tz[c]) << c;
+        tx[c] = x;
+        ty[c] = y;
+        tz[c] = z;
+      }
+    }
+
+    // at rest or with the orientation change off the orientations and cached matrices stay.
+    if (delta[3] == 0 && delta[4] == 0 && delta[5] == 0)
+    {
+      return clamped;
+    }
+
+    const bool tool = frame == SPACENAV_FRAME_TOOL;
+    // base and reference frame rotate about fixed axes (left), the others about the tool axes (right).
+    const bool left = frame == SPACENAV_FRAME_BASE || frame == SPACENAV_FRAME_REFERENCE;
+    float shared[4];
+    increment(delta[3], delta[4], delta[5], euler, shared);
+    for (int c = 0; c < count; c++)
+    {
+      if (rotationMode[c] == ROTATION_NONE)
+      {
+        continue;
+      }
+      const float *q = shared;
+      float own[4];
+      if (rotationMode[c] == ROTATION_SCALED)
+      {
+        increment(gainA[c] * delta[3], gainB[c] * delta[4], gainC[c] * delta[5], euler, own);
+        q = own;
+      }
+      float base[4] = {qw[c], qx[c], qy[c], qz[c]};
+      normalize(base);
+      float result[4];
+      if (left)
+      {
+        multiply(q, base, result);
+      }
+      else
+      {
+        multiply(base, q, result);
+      }
+      qw[c] = result[0];
+      qx[c] = result[1];
+      qy[c] = result[2];
+      qz[c] = result[3];
+      if (tool)
+      {
+        storeMatrix(c, result);
+      }
+    }
+    return clamped;
+  }
+
+private:
+  enum RotationMode
+  {
+    ROTATION_NONE,
+    ROTATION_FULL,
+    ROTATION_SCALED
+  };
+
+  /**
+   * Quaternion of the euler increments, conjugated into the reference frame if needed.
+   */
+  template <typename Euler>
+  void increment(const float a, const float b, const float c, Euler &euler, float q[4]) const
+  {
+    euler(a, b, c, q);
+    normalize(q);
+    if (frame == SPACENAV_FRAME_REFERENCE)
+    {
+      const float inverse[4] = {reference[0], -reference[1], -reference[2], -reference[3]};
+      float half[4];
+      multiply(reference, q, half);
+      multiply(half, inverse, q);
+    }
+  }
+
+  /**
+   * Hamilton product a * b.
+   */
+  static void multiply(const float a[4], const float b[4], float result[4])
+  {
+    result[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+    result[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+    result[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+    result[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+  }
+
+  /**
+   * Row-major rotation matrix of a unit quaternion.
+   */
+  static void toMatrix(const float q[4], float m[9])
+  {
+    const float w = q[0], x = q[1], y = q[2], z = q[3];
+    m[0] = 1 - 2 * (y * y + z * z);
+    m[1] = 2 * (x * y - w * z);
+    m[2] = 2 * (x * z + w * y);
+    m[3] = 2 * (x * y + w * z);
+    m[4] = 1 - 2 * (x * x + z * z);
+    m[5] = 2 * (y * z - w * x);
+    m[6] = 2 * (x * z - w * y);
+    m[7] = 2 * (y * z + w * x);
+    m[8] = 1 - 2 * (x * x + y * y);
+  }
+
+  void storeMatrix(const int c, const float q[4])
+  {
+    float m[9];
+    toMatrix(q, m);
+    r00[c] = m[0];
+    r01[c] = m[1];
+    r02[c] = m[2];
+    r10[c] = m[3];
+    r11[c] = m[4];
+    r12[c] = m[5];
+    r20[c] = m[6];
+    r21[c] = m[7];
+    r22[c] = m[8];
+  }
+
+  /**
+   * Rebuilds the rotation matrix of channel c from its quaternion.
+   */
+  void resyncChannel(const int c)
+  {
+    float q[4] = {qw[c], qx[c], qy[c], qz[c]};
+    normalize(q);
+    // the output is a unit quaternion also before the first rotation.
+    qw[c] = q[0];
+    qx[c] = q[1];
+    qy[c] = q[2];
+    qz[c] = q[3];
+    storeMatrix(c, q);
+  }
+
+  void resync()
+  {
+    for (int c = 0; c < MAX_CHANNELS; c++)
+    {
+      resyncChannel(c);
+    }
+  }
+
+  static void normalize(float q[4])
+  {
+    const float norm = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (norm > 0)
+    {
+      q[0] /= norm;
+      q[1] /= norm;
+      q[2] /= norm;
+      q[3] /= norm;
+    }
+  }
+
+  /**
+   * Folds liveness, selection, weight and enable mask into one gain per axis and channel.
+   */
+  void refresh()
+  {
+    for (int c = 0; c < MAX_CHANNELS; c++)
+    {
+      const float w = c >= count || !live[c] ? 0 : (blending ? weight[c] : (c == selected ? 1 : 0));
+      gainX[c] = enableMask[c] & 0x01 ? w : 0;
+      gainY[c] = enableMask[c] & 0x02 ? w : 0;
+      gainZ[c] = enableMask[c] & 0x04 ? w : 0;
+      gainA[c] = enableMask[c] & 0x08 ? w : 0;
+      gainB[c] = enableMask[c] & 0x10 ? w : 0;
+      gainC[c] = enableMask[c] & 0x20 ? w : 0;
+      if (gainA[c] == 0 && gainB[c] == 0 && gainC[c] == 0)
+      {
+        rotationMode[c] = ROTATION_NONE;
+      }
+      else if (gainA[c] == 1 && gainB[c] == 1 && gainC[c] == 1)
+      {
+        rotationMode[c] = ROTATION_FULL;
+      }
+      else
+      {
+        rotationMode[c] = ROTATION_SCALED;
+      }
+    }
+  }
+
+  int count;
+  int selected;
+  bool blending;
+  bool cageActive;
+  SpaceNavCommandFrame frame;
+  float reference[4];
+  float referenceMatrix[9];
+
+  float tx[MAX_CHANNELS], ty[MAX_CHANNELS], tz[MAX_CHANNELS];
+  float qw[MAX_CHANNELS], qx[MAX_CHANNELS], qy[MAX_CHANNELS], qz[MAX_CHANNELS];
+  float r00[MAX_CHANNELS], r01[MAX_CHANNELS], r02[MAX_CHANNELS];
+  float r10[MAX_CHANNELS], r11[MAX_CHANNELS], r12[MAX_CHANNELS];
+  float r20[MAX_CHANNELS], r21[MAX_CHANNELS], r22[MAX_CHANNELS];
+  float cageMinX[MAX_CHANNELS], cageMinY[MAX_CHANNELS], cageMinZ[MAX_CHANNELS];
+  float cageMaxX[MAX_CHANNELS], cageMaxY[MAX_CHANNELS], cageMaxZ[MAX_CHANNELS];
+  float gainX[MAX_CHANNELS], gainY[MAX_CHANNELS], gainZ[MAX_CHANNELS];
+  float gainA[MAX_CHANNELS], gainB[MAX_CHANNELS], gainC[MAX_CHANNELS];
+  RotationMode rotationMode[MAX_CHANNELS];
+  unsigned int enableMask[MAX_CHANNELS];
+  float weight[MAX_CHANNELS];
+  bool live[MAX_CHANNELS];
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
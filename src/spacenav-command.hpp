@@ -24,31 +24,43 @@
  *
  * ============================================================ */
 
-#include "spacenav-hid.hpp"
-#include <iostream>
-#include <stdlib.h>
-#include <stdio.h>
-#include <unistd.h>
 
-using namespace cosima::hw;
+#ifndef _COSIMA_SpaceNavCommand_H_
+#define _COSIMA_SpaceNavCommand_H_
 
-int main(int argc, char **argv)
+namespace cosima
 {
 
-    if (argc != 1)
-    {
-        exit(0);
-    }
-
-    SpaceNavHID *c = new SpaceNavHID();
-    c->initDevice();
-    SpaceNavValues c1;
-    SpaceNavValues c2;
-
-    while (1)
-    {
-        c->getValue(c1, c2);
-        std::cout << ">> x = " << c1.tx << ", y = " << c1.ty << ", z = " << c1.tz << ", rx = " << c1.rx << ", ry = " << c1.ry << ", rz = " << c1.rz << ", b0 = " << c1.button1 << ", b1 = " << c1.button2 << std::endl;
-        usleep(4000);
-    }
-}
\ No newline at end of file
+namespace hw
+{
+
+/**
+ * Fixed-size 6DoF command. Plain old data: copying it through a port is a memcpy and
+ * buffered connections can be preallocated with a fixed footprint.
+ * The fields only use types known to the RTT core typekit (see the spacenav typekit).
+ */
+struct SpaceNavCommand
+{
+  /**
+   * Kernel time stamp of the frame the command was computed from, in microseconds (CLOCK_MONOTONIC).
+   */
+  long long timestamp;
+  /**
+   * Counts every command written, gaps show commands lost on the way.
+   */
+  unsigned long long sequence;
+  /**
+   * Pressed buttons, one bit per button index (see buttonIndexToCode()).
+   */
+  unsigned long long buttons;
+  /**
+   * x, y, z, a, b, c, the same values as out_6d_port.
+   */
+  float values[6];
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
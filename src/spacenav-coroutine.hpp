@@ -0,0 +1,330 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#ifndef _COSIMA_SpaceNavCoroutine_H_
+#define _COSIMA_SpaceNavCoroutine_H_
+
+// Needs C++20, the rest of the library stays C++11.
+#include <coroutine>
+#include <exception>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "spacenav-hid.hpp"
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * A descriptor someone waits for. Owned by the waiter (e.g. inside a coroutine frame),
+ * so that waiting does not allocate.
+ */
+struct SpaceNavWatch
+{
+  int fd;
+  void (*ready)(void *context, const unsigned int events);
+  void *context;
+};
+
+/**
+ * Minimal epoll loop resuming whoever waits for a descriptor. Watches are one-shot.
+ *
+ * To run inside another event loop, watch getFileDescriptor() for readability there
+ * and call dispatch(0) when it becomes readable.
+ */
+class SpaceNavEventLoop
+{
+public:
+  SpaceNavEventLoop() : epollFd(epoll_create1(EPOLL_CLOEXEC)), pending(0), stopped(0) {}
+
+  ~SpaceNavEventLoop()
+  {
+    if (epollFd >= 0)
+    {
+      close(epollFd);
+    }
+  }
+
+  SpaceNavEventLoop(const SpaceNavEventLoop &) = delete;
+  SpaceNavEventLoop &operator=(const SpaceNavEventLoop &) = delete;
+
+  int getFileDescriptor() const
+  {
+    return epollFd;
+  }
+
+  /**
+   * Calls watch->ready once watch->fd is readable (or fails). Returns false on error.
+   */
+  bool watch(SpaceNavWatch *watch)
+  {
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = watch;
+    // re-arming is the common case, the first wait registers the descriptor.
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, watch->fd, &event) != 0 &&
+        (errno != ENOENT || epoll_ctl(epollFd, EPOLL_CTL_ADD, watch->fd, &event) != 0))
+    {
+      return false;
+    }
+    pending++;
+    return true;
+  }
+
+  /**
+   * Waits up to timeoutMs (-1 forever) and runs the ready watches.
+   * Returns the number of watches run, -1 on error or interruption.
+   */
+  int dispatch(const int timeoutMs)
+  {
+    struct epoll_event events[16];
+    const int n = epoll_wait(epollFd, events, 16, timeoutMs);
+    for (int i = 0; i < n; i++)
+    {
+      SpaceNavWatch *watch = static_cast<SpaceNavWatch *>(events[i].data.ptr);
+      pending--;
+      watch->ready(watch->context, events[i].events);
+    }
+    return n;
+  }
+
+  /**
+   * Dispatches until stop() is called or nobody waits anymore.
+   */
+  void run()
+  {
+    stopped = 0;
+    while (!stopped && pending > 0)
+    {
+      if (dispatch(-1) < 0 && errno != EINTR)
+      {
+        break;
+      }
+    }
+  }
+
+  /**
+   * Makes run() return, may be called from a signal handler.
+   */
+  void stop()
+  {
+    stopped = 1;
+  }
+
+  bool isStopped() const
+  {
+    return stopped != 0;
+  }
+
+private:
+  int epollFd;
+  int pending;
+  volatile sig_atomic_t stopped;
+};
+
+/**
+ * Result of co_await nextFrame(). Frames committed by the same read are coalesced,
+ * subscribe to SPACENAV_EVENT_FRAME to see every single one.
+ */
+struct SpaceNavFrame
+{
+  SpaceNavValues coordinates;
+  SpaceNavValues raw;
+  /**
+   * False if the device failed or disappeared.
+   */
+  bool valid;
+};
+
+/**
+ * Coroutine interface on top of a SpaceNavHID:
+ *
+ *   SpaceNavFrame frame = co_await device.nextFrame();
+ *
+ * Suspends until the device descriptor is readable and a complete frame was decoded.
+ * The awaiter lives in the awaiting coroutine frame, suspend and resume do not allocate.
+ * Only one coroutine may wait on a device at a time, and it must not be destroyed while waiting.
+ */
+class SpaceNavAsyncDevice
+{
+public:
+  SpaceNavAsyncDevice(SpaceNavHID &h, SpaceNavEventLoop &l) : hid(h), loop(l), delivered(h.getFrameCount()), fetched(delivered) {}
+
+  class FrameAwaiter
+  {
+  public:
+    explicit FrameAwaiter(SpaceNavAsyncDevice &d) : device(d), failed(false)
+    {
+      watch.fd = d.hid.getFileDescriptor();
+      watch.ready = &FrameAwaiter::onReady;
+      watch.context = this;
+    }
+
+    bool await_ready() const
+    {
+      // a frame which was decoded meanwhile is delivered without waiting.
+      return device.hid.getFrameCount() != device.delivered;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      waiting = handle;
+      if (!device.loop.watch(&watch))
+      {
+        failed = true;
+        return false;
+      }
+      return true;
+    }
+
+    SpaceNavFrame await_resume()
+    {
+      // the frame may have been committed by another reader (a subscriber or a direct
+      // getValue()), then the cached values are older than the frame count says.
+      if (device.fetched != device.hid.getFrameCount())
+      {
+        device.hid.getValue(device.coordinates, device.raw);
+        device.fetched = device.hid.getFrameCount();
+      }
+      SpaceNavFrame frame;
+      frame.valid = !failed;
+      frame.coordinates = device.coordinates;
+      frame.raw = device.raw;
+      device.delivered = device.hid.getFrameCount();
+      return frame;
+    }
+
+  private:
+    static void onReady(void *context, const unsigned int events)
+    {
+      FrameAwaiter *self = static_cast<FrameAwaiter *>(context);
+      SpaceNavAsyncDevice &d = self->device;
+      // a closed pipe reports EPOLLHUP together with the last data.
+      if (events & EPOLLIN)
+      {
+        d.hid.getValue(d.coordinates, d.raw);
+        d.fetched = d.hid.getFrameCount();
+      }
+      if (d.hid.getFrameCount() == d.delivered)
+      {
+        // half a frame: wait for the rest.
+        if (!(events & (EPOLLERR | EPOLLHUP)) && d.loop.watch(&self->watch))
+        {
+          return;
+        }
+        self->failed = true;
+      }
+      self->waiting.resume();
+    }
+
+    SpaceNavWatch watch;
+    SpaceNavAsyncDevice &device;
+    std::coroutine_handle<> waiting;
+    bool failed;
+  };
+
+  FrameAwaiter nextFrame()
+  {
+    return FrameAwaiter(*this);
+  }
+
+private:
+  SpaceNavHID &hid;
+  SpaceNavEventLoop &loop;
+  unsigned long delivered;
+  /**
+   * Frame count at which coordinates and raw were read.
+   */
+  unsigned long fetched;
+  SpaceNavValues coordinates;
+  SpaceNavValues raw;
+};
+
+/**
+ * Minimal eagerly started coroutine type, for callers without an own task type.
+ * Destroying the task destroys the coroutine.
+ */
+class SpaceNavTask
+{
+public:
+  struct promise_type
+  {
+    SpaceNavTask get_return_object()
+    {
+      return SpaceNavTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_never initial_suspend() noexcept
+    {
+      return std::suspend_never();
+    }
+    std::suspend_always final_suspend() noexcept
+    {
+      return std::suspend_always();
+    }
+    void return_void() {}
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+
+  explicit SpaceNavTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+  SpaceNavTask(SpaceNavTask &&other) noexcept : handle(other.handle)
+  {
+    other.handle = nullptr;
+  }
+
+  SpaceNavTask(const SpaceNavTask &) = delete;
+  SpaceNavTask &operator=(const SpaceNavTask &) = delete;
+
+  ~SpaceNavTask()
+  {
+    if (handle)
+    {
+      handle.destroy();
+    }
+  }
+
+  bool done() const
+  {
+    return !handle || handle.done();
+  }
+
+private:
+  std::coroutine_handle<promise_type> handle;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
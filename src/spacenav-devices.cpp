@@ -0,0 +1,108 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+// Device ids from http://spacemice.org/index.php?title=Dev and https://github.com/FreeSpacenav/spacenavd/blob/master/src/dev.c
+
+#include "spacenav-devices.hpp"
+
+#include <algorithm>
+#include <stddef.h>
+
+// All devices report the axes in evdev order, but inverted with respect to our frame.
+#define SN_IDENTITY_MAP {0, 1, 2, 3, 4, 5}, { -1, -1, -1, -1, -1, -1 }
+
+namespace cosima
+{
+
+namespace hw
+{
+
+namespace
+{
+
+/**
+ * Supported devices, sorted by vendor and product id for the binary search.
+ */
+constexpr SpaceNavDeviceInfo deviceTable[] = {
+    // Logitech's Vendor ID, used by 3DConnexion until they got their own.
+    {0x046d, 0xc603, "SpaceMouse Plus XT (untested)", 6, 15, false, SN_IDENTITY_MAP},
+    {0x046d, 0xc605, "CADMan (untested)", 6, 4, false, SN_IDENTITY_MAP},
+    {0x046d, 0xc606, "SpaceMouse Classic (untested)", 6, 8, false, SN_IDENTITY_MAP},
+    {0x046d, 0xc621, "SpaceBall 5000 (untested)", 6, 12, false, SN_IDENTITY_MAP},
+    {0x046d, 0xc623, "SpaceTraveler (untested)", 6, 8, false, SN_IDENTITY_MAP},
+    {0x046d, 0xc625, "SpacePilot (untested)", 6, 21, true, SN_IDENTITY_MAP},
+    {0x046d, 0xc626, "SpaceNavigator", 6, 2, true, SN_IDENTITY_MAP},
+    {0x046d, 0xc627, "SpaceExplorer (untested)", 6, 15, true, SN_IDENTITY_MAP},
+    {0x046d, 0xc628, "SpaceNavigator for Notebooks (untested)", 6, 2, true, SN_IDENTITY_MAP},
+    {0x046d, 0xc629, "SpacePilot Pro", 6, 31, true, SN_IDENTITY_MAP},
+    {0x046d, 0xc62b, "SpaceMouse Pro", 6, 15, true, SN_IDENTITY_MAP},
+    // 3Dconnexion's Vendor ID
+    {0x256f, 0xc62e, "SpaceMouse Wireless (cable) (untested)", 6, 2, false, SN_IDENTITY_MAP},
+    {0x256f, 0xc62f, "SpaceMouse Wireless (receiver) (untested)", 6, 2, false, SN_IDENTITY_MAP},
+    {0x256f, 0xc631, "SpaceMouse Pro Wireless (cable) (untested)", 6, 15, false, SN_IDENTITY_MAP},
+    {0x256f, 0xc632, "SpaceMouse Pro Wireless (receiver) (untested)", 6, 15, false, SN_IDENTITY_MAP},
+    {0x256f, 0xc633, "SpaceMouse Enterprise", 6, 31, false, SN_IDENTITY_MAP},
+    {0x256f, 0xc635, "SpaceMouse Compact (untested)", 6, 2, false, SN_IDENTITY_MAP},
+    {0x256f, 0xc636, "SpaceMouse Module (untested)", 6, 2, false, SN_IDENTITY_MAP},
+    {0x256f, 0xc652, "Universal Receiver (untested)", 6, 15, false, SN_IDENTITY_MAP},
+};
+
+constexpr unsigned long deviceKey(const unsigned short vendor, const unsigned short product)
+{
+  return ((unsigned long)vendor << 16) | product;
+}
+
+constexpr bool isSorted(const SpaceNavDeviceInfo *table, const size_t count)
+{
+  return count < 2 || (deviceKey(table[0].vendor, table[0].product) < deviceKey(table[1].vendor, table[1].product) && isSorted(table + 1, count - 1));
+}
+
+constexpr size_t deviceCount = sizeof(deviceTable) / sizeof(deviceTable[0]);
+
+static_assert(isSorted(deviceTable, deviceCount), "deviceTable needs to be sorted by vendor and product id");
+
+bool lessThanKey(const SpaceNavDeviceInfo &info, const unsigned long key)
+{
+  return deviceKey(info.vendor, info.product) < key;
+}
+
+} // namespace
+
+const SpaceNavDeviceInfo *findDeviceInfo(const unsigned short vendor, const unsigned short product)
+{
+  const unsigned long key = deviceKey(vendor, product);
+  const SpaceNavDeviceInfo *end = deviceTable + deviceCount;
+  const SpaceNavDeviceInfo *it = std::lower_bound(deviceTable, end, key, lessThanKey);
+  if (it == end || deviceKey(it->vendor, it->product) != key)
+  {
+    return NULL;
+  }
+  return it;
+}
+
+} // namespace hw
+
+} // namespace cosima
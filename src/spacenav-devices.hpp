@@ -0,0 +1,114 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavDevices_H_
+#define _COSIMA_SpaceNavDevices_H_
+
+#include <linux/input.h>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Capabilities of a supported 3Dconnexion device.
+ */
+struct SpaceNavDeviceInfo
+{
+  unsigned short vendor;
+  unsigned short product;
+  const char *name;
+  int numAxes;
+  int numButtons;
+  /**
+   * Whether the device accepts EV_LED (LED_MISC) writes.
+   */
+  bool hasLed;
+  /**
+   * evdev axis (ABS_X + index) which feeds the logical tx, ty, tz, rx, ry, rz.
+   */
+  int axisMap[6];
+  /**
+   * Sign applied to the logical axes after scaling.
+   */
+  int axisSign[6];
+};
+
+/**
+ * Looks up the capabilities of a device by vendor and product id.
+ * Returns NULL if the device is not supported.
+ */
+const SpaceNavDeviceInfo *findDeviceInfo(const unsigned short vendor, const unsigned short product);
+
+/**
+ * Buttons which hid-input maps to BTN_MISC + index (BTN_0 == BTN_MISC) on a multi-axis
+ * controller, the following ones become BTN_TRIGGER_HAPPY + (index - 16).
+ */
+const int NUM_MISC_BUTTONS = 16;
+
+/**
+ * evdev key code of a button index, -1 if the kernel has no code for it.
+ */
+inline int buttonIndexToCode(const int index)
+{
+  if (index < 0)
+  {
+    return -1;
+  }
+  if (index < NUM_MISC_BUTTONS)
+  {
+    return BTN_MISC + index;
+  }
+  if (index < NUM_MISC_BUTTONS + (BTN_TRIGGER_HAPPY40 - BTN_TRIGGER_HAPPY + 1))
+  {
+    return BTN_TRIGGER_HAPPY + index - NUM_MISC_BUTTONS;
+  }
+  return -1;
+}
+
+/**
+ * Button index of an evdev key code, -1 if the code is no button of a multi-axis controller.
+ */
+inline int buttonCodeToIndex(const int code)
+{
+  if (code >= BTN_MISC && code < BTN_MISC + NUM_MISC_BUTTONS)
+  {
+    return code - BTN_MISC;
+  }
+  if (code >= BTN_TRIGGER_HAPPY && code <= BTN_TRIGGER_HAPPY40)
+  {
+    return code - BTN_TRIGGER_HAPPY + NUM_MISC_BUTTONS;
+  }
+  return -1;
+}
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
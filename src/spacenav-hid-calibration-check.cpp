@@ -0,0 +1,162 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "spacenav-calibration.hpp"
+#include "spacenav-history.hpp"
+#include <iostream>
+#include <random>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+
+using namespace cosima::hw;
+
+/**
+ * Offline check of SpaceNavCalibrator: feeds a synthetic stream of a device that rests off
+ * center into a history and verifies that the calibration finds the bias and the noise.
+ * The stream follows the model of spacenav-hid-sim (-b bias, -n sigma): the device is moved
+ * for the first seconds, rests afterwards and is pushed for half a second every five seconds.
+ */
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  -b bias       rest offset of the axes, with alternating sign (default 200 of a half range of 350)\n"
+              << "  -n sigma      standard deviation of the sensor noise (default 3)\n"
+              << "  -a amplitude  amplitude of the motion and the pushes (default 120)\n"
+              << "  -m seconds    motion before the first rest (default 2)\n"
+              << "  -t seconds    duration of the stream (default 30)\n"
+              << "  -r rate       frames per second (default 250)\n";
+}
+
+int main(int argc, char **argv)
+{
+    double bias = 200, noise = 3, amplitude = 120, motion = 2, duration = 30, rate = 250;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:a:m:t:r:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            bias = atof(optarg);
+            break;
+        case 'n':
+            noise = atof(optarg);
+            break;
+        case 'a':
+            amplitude = atof(optarg);
+            break;
+        case 'm':
+            motion = atof(optarg);
+            break;
+        case 't':
+            duration = atof(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (rate <= 0 || duration <= 0 || noise < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SpaceNavHistory history(1000000);
+    SpaceNavCalibrator calibrator;
+    for (int i = 0; i < 6; i++)
+    {
+        calibrator.setRange(i, -350, 350);
+    }
+    calibrator.reset();
+
+    std::mt19937 generator(1);
+    std::normal_distribution<double> gaussian(0, noise > 0 ? noise : 1);
+    const long long frames = (long long)(duration * rate);
+    // the background thread of the calibrator runs about once a second.
+    const long long updateEvery = rate > 1 ? (long long)rate : 1;
+    double calibratedAt = -1;
+
+    for (long long n = 0; n < frames; n++)
+    {
+        const double t = n / rate;
+        // pushes start 2.5 s into every 5 s of rest.
+        const double push = fmod(t - motion, 5.0) - 2.5;
+        int axes[6];
+        for (int i = 0; i < 6; i++)
+        {
+            double value = i % 2 ? -bias : bias;
+            if (t < motion)
+            {
+                value += amplitude * sin(2 * M_PI * 0.5 * t + i * M_PI / 3);
+            }
+            else if (push >= 0 && push < 0.5)
+            {
+                value += amplitude * sin(M_PI * push / 0.5) * (i < 3 ? 1 : -1);
+            }
+            value += noise > 0 ? gaussian(generator) : 0;
+            axes[i] = (int)lround(value < -350 ? -350 : (value > 350 ? 350 : value));
+        }
+        history.push((long long)(t * 1e6), axes, 0);
+
+        SpaceNavCalibration calibration;
+        if ((n + 1) % updateEvery == 0 && calibrator.update(history) && calibratedAt < 0 && calibrator.getCalibration(calibration))
+        {
+            calibratedAt = t;
+        }
+    }
+    calibrator.update(history);
+
+    SpaceNavCalibration calibration;
+    if (!calibrator.getCalibration(calibration))
+    {
+        std::cout << "No calibration after " << duration << " s (bias " << bias << ", noise " << noise << ")" << std::endl;
+        return 1;
+    }
+
+    // thousands of rest frames pin bias and noise down to a few percent of the noise; the
+    // flanks of the pushes must not widen the noise (0 without noise).
+    const double biasTolerance = 0.1 + noise / 20;
+    const double noiseTolerance = 0.05 + noise / 20;
+    bool ok = true;
+    printf("calibrated after %.1f s from %llu rest frames\n", calibratedAt, calibration.samples);
+    printf("axis      bias  expected     noise  expected  deadzone\n");
+    for (int i = 0; i < 6; i++)
+    {
+        const SpaceNavAxisCalibration &axis = calibration.axes[i];
+        const double expected = i % 2 ? -bias : bias;
+        const bool good = fabs(axis.bias - expected) <= biasTolerance && fabs(axis.noise - noise) <= noiseTolerance;
+        ok = ok && good;
+        printf("%4d %9.2f %9.2f %9.2f %9.2f %9.2f%s\n", i, axis.bias, expected, axis.noise, noise, axis.deadzone, good ? "" : "  FAILED");
+    }
+    return ok ? 0 : 1;
+}
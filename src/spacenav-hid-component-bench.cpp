@@ -0,0 +1,462 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "orocos/spacenav-orocos.hpp"
+#include "spacenav-latency.hpp"
+#include <rtt/Activity.hpp>
+#include <rtt/Property.hpp>
+#include <rtt/extras/FileDescriptorActivity.hpp>
+#include <rtt/extras/SlaveActivity.hpp>
+#include <linux/input.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <math.h>
+
+using namespace cosima::hw;
+
+/**
+ * Headless benchmark of the SpaceNavOrocos component: a pipe replaces the device and sink
+ * components receive the outputs. Reports the cost of updateHook, the frames per second and
+ * latency (frame time stamp to sink) end to end and the jitter of the updates, per activity
+ * and pose path.
+ */
+
+static long long nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Writes frame n of a slow sine on all axes, stamped with the current time like a device
+ * switched to CLOCK_MONOTONIC.
+ */
+static bool writeFrame(const int fd, const unsigned long n, const double rate)
+{
+    struct input_event events[7];
+    memset(events, 0, sizeof events);
+    const long long now = nowNs();
+    const double t = n / rate;
+    for (int i = 0; i < 7; i++)
+    {
+        events[i].time.tv_sec = now / 1000000000LL;
+        events[i].time.tv_usec = (now % 1000000000LL) / 1000;
+        events[i].type = i < 6 ? EV_ABS : EV_SYN;
+        events[i].code = i < 6 ? ABS_X + i : SYN_REPORT;
+        events[i].value = i < 6 ? (int)lround(350 * sin(2 * M_PI * 0.5 * t + i * M_PI / 3)) : 0;
+    }
+    return write(fd, events, sizeof events) == (ssize_t)sizeof events;
+}
+
+/**
+ * The component reading from a pipe, timing every update.
+ */
+class BenchComponent : public SpaceNavOrocos
+{
+public:
+    BenchComponent(const int source, const double nominalUs) : SpaceNavOrocos("bench"),
+                                                               source(source),
+                                                               nominalUs(nominalUs),
+                                                               updates(0),
+                                                               lastUpdate(-1)
+    {
+    }
+
+    void updateHook()
+    {
+        const long long start = nowNs();
+        SpaceNavOrocos::updateHook();
+        cost.add(nowNs() - start);
+        if (lastUpdate >= 0 && nominalUs > 0)
+        {
+            jitter.add((long long)fabs((start - lastUpdate) / 1000.0 - nominalUs));
+        }
+        lastUpdate = start;
+        updates++;
+    }
+
+    /**
+     * updateHook in ns, deviation of the update intervals from the nominal one in us.
+     */
+    SpaceNavLatencyHistogram cost;
+    SpaceNavLatencyHistogram jitter;
+
+    int source;
+    double nominalUs;
+    unsigned long updates;
+    long long lastUpdate;
+
+protected:
+    bool openInterface()
+    {
+        // the interface closes its descriptor on cleanup.
+        return interface->attachDescriptor(dup(source), findDeviceInfo(0x046d, 0xc626));
+    }
+};
+
+/**
+ * Receives the command and the 6D or pose output, triggered by the command port.
+ */
+class BenchSink : public RTT::TaskContext
+{
+public:
+    BenchSink() : RTT::TaskContext("sink"),
+                  in_command_port("in_command_port"),
+                  in_6d_port("in_6d_port"),
+#ifdef USE_RSTRT
+                  in_pose_port("in_pose_port"),
+#endif
+                  frames(0),
+                  outputs(0),
+                  lastTimestamp(-1)
+    {
+        ports()->addEventPort(in_command_port);
+        ports()->addPort(in_6d_port);
+#ifdef USE_RSTRT
+        ports()->addPort(in_pose_port);
+#endif
+    }
+
+    void updateHook()
+    {
+        SpaceNavCommand command;
+        while (in_command_port.read(command) == RTT::NewData)
+        {
+            // commands are also written on updates without a new frame.
+            if (command.timestamp != lastTimestamp)
+            {
+                lastTimestamp = command.timestamp;
+                latency.add(nowNs() / 1000 - command.timestamp);
+                frames++;
+            }
+        }
+        while (in_6d_port.read(sample6d) == RTT::NewData)
+        {
+            outputs++;
+        }
+#ifdef USE_RSTRT
+        while (in_pose_port.read(pose) == RTT::NewData)
+        {
+            outputs++;
+        }
+#endif
+    }
+
+    RTT::InputPort<SpaceNavCommand> in_command_port;
+    RTT::InputPort<Eigen::VectorXf> in_6d_port;
+    Eigen::VectorXf sample6d;
+#ifdef USE_RSTRT
+    RTT::InputPort<rstrt::geometry::Pose> in_pose_port;
+    rstrt::geometry::Pose pose;
+#endif
+    /**
+     * Distinct frames and outputs of the 6D or pose port received.
+     */
+    unsigned long frames;
+    unsigned long outputs;
+    long long lastTimestamp;
+    SpaceNavLatencyHistogram latency;
+};
+
+struct BenchResult
+{
+    std::string activity;
+    std::string path;
+    double seconds;
+    unsigned long written;
+    unsigned long updates;
+    unsigned long frames;
+    unsigned long outputs;
+    SpaceNavLatencyHistogram cost;
+    SpaceNavLatencyHistogram jitter;
+    SpaceNavLatencyHistogram latency;
+};
+
+struct BenchOptions
+{
+    double rate;
+    double duration;
+    unsigned long iterations;
+    double periodicRate;
+};
+
+static bool runBench(const std::string &activity, const std::string &path, const BenchOptions &options, BenchResult &result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+
+    const double nominalUs = activity == "fd" ? 1e6 / options.rate : (activity == "periodic" ? 1e6 / options.periodicRate : 0);
+    BenchComponent *sn = new BenchComponent(fds[0], nominalUs);
+    BenchSink *sink = new BenchSink();
+    // the component takes ownership of its activity.
+    if (activity == "fd")
+    {
+        sn->setActivity(new RTT::extras::FileDescriptorActivity(ORO_SCHED_OTHER, 0));
+    }
+    else if (activity == "periodic")
+    {
+        sn->setActivity(new RTT::Activity(ORO_SCHED_OTHER, 0, 1.0 / options.periodicRate));
+    }
+    else
+    {
+        sn->setActivity(new RTT::extras::SlaveActivity());
+    }
+
+#ifdef USE_RSTRT
+    RTT::OutputPort<rstrt::geometry::Pose> poseSource("bench_pose");
+    if (path == "cage")
+    {
+        RTT::Property<bool> cage(sn->getProperty("isCageActive"));
+        cage.set(true);
+    }
+#endif
+
+    // the driver is chatty while opening the device.
+    std::ofstream devnull("/dev/null");
+    std::streambuf *out = std::cout.rdbuf(devnull.rdbuf());
+    const bool configured = sn->configure();
+    std::cout.rdbuf(out);
+    if (!configured)
+    {
+        std::cerr << "Unable to configure the component." << std::endl;
+        delete sink;
+        delete sn;
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    sink->in_command_port.connectTo(sn->getPort("out_command_port"), RTT::ConnPolicy::buffer(4096));
+#ifdef USE_RSTRT
+    if (path != "6d")
+    {
+        sink->in_pose_port.connectTo(sn->getPort("out_pose_port"), RTT::ConnPolicy::buffer(4096));
+        poseSource.connectTo(sn->getPort("in_current_pose_port"), RTT::ConnPolicy::data());
+        rstrt::geometry::Pose initial;
+        initial.translation.translation << 0.3, 0.0, 0.3;
+        initial.rotation.rotation << 1, 0, 0, 0;
+        poseSource.write(initial);
+    }
+    else
+#endif
+    {
+        sink->in_6d_port.connectTo(sn->getPort("out_6d_port"), RTT::ConnPolicy::buffer(4096));
+    }
+    sink->start();
+    sn->start();
+
+    result.activity = activity;
+    result.path = path;
+    result.written = 0;
+    const long long start = nowNs();
+    if (activity == "direct")
+    {
+        // one frame per update, without any wake-up in between.
+        for (unsigned long n = 0; n < options.iterations; n++)
+        {
+            result.written += writeFrame(fds[1], n, options.rate) ? 1 : 0;
+            sn->updateHook();
+        }
+    }
+    else
+    {
+        const long long period = (long long)(1e9 / options.rate);
+        const long long end = start + (long long)(options.duration * 1e9);
+        for (unsigned long n = 0; start + (long long)n * period < end; n++)
+        {
+            const long long deadline = start + n * period;
+            struct timespec ts;
+            ts.tv_sec = deadline / 1000000000LL;
+            ts.tv_nsec = deadline % 1000000000LL;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            result.written += writeFrame(fds[1], n, options.rate) ? 1 : 0;
+        }
+    }
+    result.seconds = (nowNs() - start) * 1e-9;
+    // let the last frames arrive.
+    usleep(100000);
+
+    sn->stop();
+    sink->stop();
+    result.updates = sn->updates;
+    result.cost = sn->cost;
+    result.jitter = sn->jitter;
+    result.frames = sink->frames;
+    result.outputs = sink->outputs;
+    result.latency = sink->latency;
+
+    sn->cleanup();
+    delete sink;
+    delete sn;
+    close(fds[0]);
+    close(fds[1]);
+    return true;
+}
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "Runs the SpaceNavOrocos component without deployer and device and reports its cost.\n"
+              << "  -a a1,a2,...  activities: direct (updateHook called in a loop), fd, periodic (default all)\n"
+#ifdef USE_RSTRT
+              << "  -p p1,p2,...  paths: 6d, pose, cage (pose with cage) (default all)\n"
+#endif
+              << "  -r rate       frames per second written to the pipe (default 1000)\n"
+              << "  -t seconds    duration per run of fd and periodic (default 5)\n"
+              << "  -n frames     frames per run of direct (default 100000)\n"
+              << "  -P rate       update rate of the periodic activity (default 1000)\n"
+              << "  -o file       also write the report as CSV\n";
+}
+
+static std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        items.push_back(item);
+    }
+    return items;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> activities = split("direct,fd,periodic");
+#ifdef USE_RSTRT
+    std::vector<std::string> paths = split("6d,pose,cage");
+#else
+    std::vector<std::string> paths = split("6d");
+#endif
+    BenchOptions options;
+    options.rate = 1000;
+    options.duration = 5;
+    options.iterations = 100000;
+    options.periodicRate = 1000;
+    const char *csv = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:r:t:n:P:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            activities = split(optarg);
+            break;
+#ifdef USE_RSTRT
+        case 'p':
+            paths = split(optarg);
+            break;
+#endif
+        case 'r':
+            options.rate = atof(optarg);
+            break;
+        case 't':
+            options.duration = atof(optarg);
+            break;
+        case 'n':
+            options.iterations = strtoul(optarg, NULL, 10);
+            break;
+        case 'P':
+            options.periodicRate = atof(optarg);
+            break;
+        case 'o':
+            csv = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (options.rate <= 0 || options.periodicRate <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<BenchResult *> results;
+    std::cout << std::setw(10) << "activity" << std::setw(6) << "path" << std::setw(9) << "written" << std::setw(9) << "updates"
+              << std::setw(9) << "frames/s" << std::setw(9) << "outputs" << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns" << std::setw(10) << "max ns"
+              << std::setw(9) << "lat p50" << std::setw(9) << "lat p99" << std::setw(9) << "lat max" << std::setw(9) << "jit p99" << std::setw(9) << "jit max" << std::endl;
+    for (size_t a = 0; a < activities.size(); a++)
+    {
+        for (size_t p = 0; p < paths.size(); p++)
+        {
+            BenchResult *result = new BenchResult();
+            if (!runBench(activities[a], paths[p], options, *result))
+            {
+                delete result;
+                continue;
+            }
+            results.push_back(result);
+            const bool timed = result->activity != "direct";
+            std::cout << std::setw(10) << result->activity << std::setw(6) << result->path << std::setw(9) << result->written << std::setw(9) << result->updates
+                      << std::setw(9) << std::fixed << std::setprecision(0) << result->frames / result->seconds << std::setw(9) << result->outputs
+                      << std::setw(10) << result->cost.percentile(0.5) << std::setw(10) << result->cost.percentile(0.99) << std::setw(10) << result->cost.max
+                      << std::setw(9) << result->latency.percentile(0.5) << std::setw(9) << result->latency.percentile(0.99) << std::setw(9) << result->latency.max
+                      << std::setw(9) << (timed ? std::to_string(result->jitter.percentile(0.99)) : "-") << std::setw(9) << (timed ? std::to_string(result->jitter.max) : "-")
+                      << std::endl;
+        }
+    }
+    std::cout << "Cost of updateHook in ns (percentiles capped at 100 us), latency from frame time stamp to the sink and jitter\n"
+              << "of the update intervals against the frame (fd) or activity (periodic) period in us." << std::endl;
+
+    if (csv)
+    {
+        std::ofstream file(csv);
+        file << "activity,path,seconds,written,updates,frames,outputs,cost_p50_ns,cost_p99_ns,cost_max_ns,latency_p50_us,latency_p99_us,latency_max_us,jitter_p99_us,jitter_max_us\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult &r = *results[i];
+            file << r.activity << "," << r.path << "," << r.seconds << "," << r.written << "," << r.updates << "," << r.frames << "," << r.outputs << ","
+                 << r.cost.percentile(0.5) << "," << r.cost.percentile(0.99) << "," << r.cost.max << ","
+                 << r.latency.percentile(0.5) << "," << r.latency.percentile(0.99) << "," << r.latency.max << ","
+                 << r.jitter.percentile(0.99) << "," << r.jitter.max << "\n";
+        }
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        delete results[i];
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+// Example for the C++20 coroutine interface, built only if the compiler supports it.
+
+#include "spacenav-coroutine.hpp"
+#include <iostream>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+
+using namespace cosima::hw;
+
+static SpaceNavEventLoop *activeLoop = NULL;
+
+static void stop(int)
+{
+    if (activeLoop)
+    {
+        activeLoop->stop();
+    }
+}
+
+static SpaceNavTask printFrames(SpaceNavAsyncDevice &device, const long count)
+{
+    for (long i = 0; count <= 0 || i < count; i++)
+    {
+        const SpaceNavFrame frame = co_await device.nextFrame();
+        if (!frame.valid)
+        {
+            std::cerr << "Device is gone." << std::endl;
+            break;
+        }
+        const SpaceNavValues &v = frame.coordinates;
+        printf("%lld %g %g %g %g %g %g %llu\n", frame.raw.timestamp, v.tx, v.ty, v.tz, v.rx, v.ry, v.rz, (unsigned long long)v.buttons.bits);
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long count = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            count = atol(optarg);
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-n frames]\n"
+                      << "Prints the scaled frames of the first SpaceNav device from a coroutine.\n";
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    SpaceNavHID hid;
+    if (!hid.initDevice())
+    {
+        return 1;
+    }
+
+    SpaceNavEventLoop loop;
+    SpaceNavAsyncDevice device(hid, loop);
+    activeLoop = &loop;
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    SpaceNavTask task = printFrames(device, count);
+    // returns once the task is done (nobody waits anymore) or on a signal.
+    loop.run();
+    activeLoop = NULL;
+    hid.closeDevice();
+    return task.done() ? 0 : 1;
+}
@@ -0,0 +1,279 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-hid.hpp"
+#include "spacenav-latency.hpp"
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+
+using namespace cosima::hw;
+
+enum OutputFormat
+{
+    FORMAT_TEXT,
+    FORMAT_JSON,
+    FORMAT_BINARY,
+    FORMAT_NONE
+};
+
+/**
+ * Record of the binary output format, native byte order.
+ */
+struct MonitorRecord
+{
+    int64_t timestamp; // us, CLOCK_MONOTONIC
+    float axes[6];
+    uint64_t buttons;
+} __attribute__((packed));
+
+/**
+ * Output state, handed to the frame callback.
+ */
+struct Monitor
+{
+    FILE *out;
+    OutputFormat format;
+    bool scaled;
+    bool latency;
+    SpaceNavLatencyHistogram histogram;
+    long long firstStamp;
+
+    void onFrame(const SpaceNavEvent &event);
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int)
+{
+    running = 0;
+}
+
+static long long nowUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+void Monitor::onFrame(const SpaceNavEvent &event)
+{
+    const SpaceNavValues &raw = *event.raw;
+    if (latency)
+    {
+        histogram.add(nowUs() - raw.timestamp);
+    }
+    if (firstStamp < 0)
+    {
+        firstStamp = raw.timestamp;
+    }
+
+    const SpaceNavValues &v = scaled ? *event.scaled : raw;
+    const double t = (raw.timestamp - firstStamp) / 1000.0;
+    switch (format)
+    {
+    case FORMAT_TEXT:
+        fprintf(out, "%.3f %g %g %g %g %g %g %llu\n", t, v.tx, v.ty, v.tz, v.rx, v.ry, v.rz, (unsigned long long)v.buttons.bits);
+        break;
+    case FORMAT_JSON:
+        fprintf(out, "{\"t\":%.3f,\"timestamp\":%lld,\"tx\":%g,\"ty\":%g,\"tz\":%g,\"rx\":%g,\"ry\":%g,\"rz\":%g,\"buttons\":%llu}\n",
+                t, raw.timestamp, v.tx, v.ty, v.tz, v.rx, v.ry, v.rz, (unsigned long long)v.buttons.bits);
+        break;
+    case FORMAT_BINARY:
+    {
+        MonitorRecord record;
+        record.timestamp = raw.timestamp;
+        record.axes[0] = v.tx;
+        record.axes[1] = v.ty;
+        record.axes[2] = v.tz;
+        record.axes[3] = v.rx;
+        record.axes[4] = v.ry;
+        record.axes[5] = v.rz;
+        record.buttons = v.buttons.bits;
+        fwrite(&record, sizeof record, 1, out);
+        break;
+    }
+    case FORMAT_NONE:
+        break;
+    }
+}
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "Prints the frames of the first SpaceNav device, waking up only when the device has data.\n"
+              << "  -f text|json|binary|none  output format (default text)\n"
+              << "  -c                        print scaled coordinates (toggle state for buttons) instead of raw values\n"
+              << "  -o file                   capture to file instead of stdout\n"
+              << "  -s                        print rate statistics to stderr every second\n"
+              << "  -l                        print a latency summary (kernel time stamp to decode) on exit\n"
+              << "The text format of the raw values (time_ms tx ty tz rx ry rz buttons) can be replayed with spacenav-hid-sim.\n";
+}
+
+int main(int argc, char **argv)
+{
+    OutputFormat format = FORMAT_TEXT;
+    bool scaled = false, statistics = false, latency = false;
+    const char *capture = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:co:slh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            if (strcmp(optarg, "text") == 0)
+                format = FORMAT_TEXT;
+            else if (strcmp(optarg, "json") == 0)
+                format = FORMAT_JSON;
+            else if (strcmp(optarg, "binary") == 0)
+                format = FORMAT_BINARY;
+            else if (strcmp(optarg, "none") == 0)
+                format = FORMAT_NONE;
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'c':
+            scaled = true;
+            break;
+        case 'o':
+            capture = optarg;
+            break;
+        case 's':
+            statistics = true;
+            break;
+        case 'l':
+            latency = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if (capture && !(out = fopen(capture, format == FORMAT_BINARY ? "wb" : "w")))
+    {
+        perror("opening the capture file");
+        return 1;
+    }
+    if (format == FORMAT_BINARY && !capture && isatty(fileno(stdout)))
+    {
+        std::cerr << "Refusing to write binary output to a terminal, use -o." << std::endl;
+        return 1;
+    }
+
+    // keep stdout free for the frames.
+    std::streambuf *cout = std::cout.rdbuf(std::cerr.rdbuf());
+    SpaceNavHID hid;
+    if (!hid.initDevice())
+    {
+        return 1;
+    }
+    std::cout.rdbuf(cout);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    // every committed frame is printed, also when one read contains several.
+    Monitor monitor;
+    monitor.out = out;
+    monitor.format = format;
+    monitor.scaled = scaled;
+    monitor.latency = latency;
+    monitor.firstStamp = -1;
+    hid.subscribe<Monitor, &Monitor::onFrame>(SPACENAV_EVENT_FRAME, &monitor);
+
+    SpaceNavValues coordinates, raw;
+    struct pollfd pfd;
+    pfd.fd = hid.getFileDescriptor();
+    pfd.events = POLLIN;
+
+    long long statsStart = nowUs();
+    unsigned long wakeups = 0, framesStart = hid.getFrameCount(), droppedStart = hid.getDroppedCount();
+
+    while (running)
+    {
+        // block until the device has data, only wake up for the statistics.
+        const int ready = poll(&pfd, 1, statistics ? 1000 : -1);
+        if (ready < 0)
+        {
+            continue;
+        }
+        if (ready > 0)
+        {
+            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                std::cerr << "Device is gone." << std::endl;
+                break;
+            }
+            wakeups++;
+            hid.getValue(coordinates, raw);
+            SpaceNavButtonEvent event;
+            while (hid.popButtonEvent(event))
+            {
+            }
+        }
+
+        if (statistics)
+        {
+            const long long now = nowUs();
+            if (now - statsStart >= 1000000)
+            {
+                const double seconds = (now - statsStart) * 1e-6;
+                fprintf(stderr, "frames/s %.0f  wakeups/s %.0f  dropped %lu\n",
+                        (hid.getFrameCount() - framesStart) / seconds, wakeups / seconds, hid.getDroppedCount() - droppedStart);
+                statsStart = now;
+                framesStart = hid.getFrameCount();
+                droppedStart = hid.getDroppedCount();
+                wakeups = 0;
+            }
+        }
+    }
+
+    fflush(out);
+    if (capture)
+    {
+        fclose(out);
+    }
+    if (latency)
+    {
+        fprintf(stderr, "latency over %lu frames: mean %.1f us, p50 %lld us, p99 %lld us, max %lld us\n",
+                monitor.histogram.count, monitor.histogram.mean(), monitor.histogram.percentile(0.5), monitor.histogram.percentile(0.99), monitor.histogram.max);
+    }
+    hid.closeDevice();
+    return 0;
+}
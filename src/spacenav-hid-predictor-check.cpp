@@ -0,0 +1,139 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "spacenav-predictor.hpp"
+#include <iostream>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+
+using namespace cosima::hw;
+
+/**
+ * Offline check of SpaceNavPredictor: the cap is pushed, held and released, then the device
+ * falls silent like a SpaceNavigator at rest while the component keeps updating (shaping
+ * timer, periodic activity). The prediction has to return to the last measurement, 0 after
+ * the release, instead of extrapolating the release further.
+ */
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  -r rate       frames per second of the device (default 125)\n"
+              << "  -u period     update period of the component while silent, in ms (default 1)\n"
+              << "  -l latency    predicted latency, in ms (default 20)\n";
+}
+
+/**
+ * Runs the updates of the component between two frames (or until end while silent) and
+ * returns the largest deviation from expected after settle microseconds without frames.
+ */
+static double idle(SpaceNavPredictor &predictor, const long long from, const long long end, const long long step,
+                   const long long horizon, const long long lastFrame, const long long settle, const double expected)
+{
+    double worst = 0;
+    for (long long now = from; now < end; now += step)
+    {
+        double out[6];
+        predictor.predict(now, horizon, out);
+        for (int a = 0; a < 6; a++)
+        {
+            if (fabs(out[a]) > 500)
+            {
+                return INFINITY;
+            }
+            if (now - lastFrame >= settle && fabs(out[a] - (a % 2 ? -expected : expected)) > worst)
+            {
+                worst = fabs(out[a] - (a % 2 ? -expected : expected));
+            }
+        }
+    }
+    return worst;
+}
+
+int main(int argc, char **argv)
+{
+    double rate = 125, updateMs = 1, latencyMs = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:u:l:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'u':
+            updateMs = atof(optarg);
+            break;
+        case 'l':
+            latencyMs = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (rate <= 0 || updateMs <= 0 || latencyMs < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const long long period = (long long)(1e6 / rate);
+    const long long step = (long long)(updateMs * 1000) > 0 ? (long long)(updateMs * 1000) : 1;
+    const long long horizon = (long long)(latencyMs * 1000);
+    // two frame periods without frames plus the update period.
+    const long long settle = (2 * period > SpaceNavPredictor::MIN_SILENCE ? 2 * period : SpaceNavPredictor::MIN_SILENCE) + step;
+
+    bool ok = true;
+    // push to 400 within 0.3 s, hold and then release back to 0 (end 0) or stop sending while held (end 300).
+    const double ends[2] = {0, 300};
+    for (int scenario = 0; scenario < 2; scenario++)
+    {
+        SpaceNavPredictor predictor;
+        predictor.setLimit(500.0);
+        long long t = 1000000;
+        double value = 0;
+        for (int n = 0; n < (int)(0.6 * rate); n++)
+        {
+            const double s = n / rate;
+            value = s < 0.3 ? 400 * s / 0.3 : (s < 0.4 ? 400 : 400 + (ends[scenario] - 400) * (s - 0.4) / 0.2);
+            value = s >= 0.6 - 1 / rate ? ends[scenario] : value;
+            const double z[6] = {value, -value, value, -value, value, -value};
+            predictor.update(t, z);
+            idle(predictor, t, t + period, step, horizon, t, period, 0);
+            t += period;
+        }
+        const double worst = idle(predictor, t - period, t + 2000000, step, horizon, t - period, settle, value);
+        const bool good = worst <= 1e-6;
+        ok = ok && good;
+        printf("%-8s last frame %6.1f, deviation after %5.1f ms of silence %s%s\n", scenario ? "hold" : "release", value,
+               settle * 1e-3, isinf(worst) ? "beyond the limit" : (good ? "0" : "too large"), good ? "" : "  FAILED");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "spacenav-hid.hpp"
+#include "spacenav-uinput.hpp"
+#include <iostream>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <math.h>
+#include <time.h>
+
+using namespace cosima::hw;
+
+/**
+ * Processing between the physical and the virtual device, handed to the frame callback.
+ * Works in device axis order and sign, so consumers keep their per-model conventions.
+ */
+struct Reemitter
+{
+    SpaceNavVirtualDevice *output;
+    const SpaceNavDeviceInfo *info;
+    bool normalize;
+    int deadzone;
+    double alpha;
+    double filtered[6];
+    int emitted[6];
+    SpaceNavButtons emittedButtons;
+    bool first;
+    unsigned long frames;
+    unsigned long suppressed;
+
+    void onFrame(const SpaceNavEvent &event);
+};
+
+void Reemitter::onFrame(const SpaceNavEvent &event)
+{
+    frames++;
+    const SpaceNavValues &raw = *event.raw;
+    double values[6] = {raw.tx, raw.ty, raw.tz, raw.rx, raw.ry, raw.rz};
+    if (normalize)
+    {
+        // undo the remapping of the scaled values, the sign is +-1.
+        const SpaceNavValues &scaled = *event.scaled;
+        const double logical[6] = {scaled.tx, scaled.ty, scaled.tz, scaled.rx, scaled.ry, scaled.rz};
+        for (int i = 0; i < 6; i++)
+        {
+            values[info->axisMap[i]] = logical[i] * info->axisSign[i];
+        }
+    }
+
+    int axes[6];
+    bool changed = first || raw.buttons.bits != emittedButtons.bits;
+    for (int i = 0; i < 6; i++)
+    {
+        filtered[i] = first ? values[i] : filtered[i] + alpha * (values[i] - filtered[i]);
+        const int value = (int)lround(filtered[i]);
+        axes[i] = abs(value) <= deadzone ? 0 : value;
+        changed = changed || axes[i] != emitted[i];
+    }
+    first = false;
+
+    // noise below the deadzone does not wake up the consumers.
+    if (!changed)
+    {
+        suppressed++;
+        return;
+    }
+    if (output->emitFrame(axes, raw.buttons))
+    {
+        memcpy(emitted, axes, sizeof emitted);
+        emittedButtons = raw.buttons;
+    }
+}
+
+static long long nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int)
+{
+    running = 0;
+}
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "Grabs the first SpaceNav device and re-emits its processed stream through a virtual uinput device,\n"
+              << "so that every other application reads the same cleaned-up values.\n"
+              << "  -d deadzone  values with a magnitude up to deadzone become 0 (default 0)\n"
+              << "  -a alpha     exponential smoothing, 0 < alpha <= 1 (default 1, no smoothing)\n"
+              << "  -n           emit values normalized to [-500, 500] instead of the device range\n"
+              << "  -G           do not grab the physical device\n"
+              << "  -s           print statistics to stderr every second\n";
+}
+
+int main(int argc, char **argv)
+{
+    int deadzone = 0;
+    double alpha = 1.0;
+    bool normalize = false, grab = true, statistics = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:a:nGsh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            deadzone = atoi(optarg);
+            break;
+        case 'a':
+            alpha = atof(optarg);
+            break;
+        case 'n':
+            normalize = true;
+            break;
+        case 'G':
+            grab = false;
+            break;
+        case 's':
+            statistics = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (alpha <= 0 || alpha > 1 || deadzone < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // the physical device needs to be opened first, the virtual one carries the same ids.
+    // Never pick up a virtual device, e.g. the one of a previous run which is still around.
+    SpaceNavHID hid;
+    hid.setVirtualDevicesAllowed(false);
+    if (!hid.initDevice())
+    {
+        return 1;
+    }
+    if (grab && !hid.setExclusive(true))
+    {
+        perror("[SpaceNavHID] grabbing the device");
+        return 1;
+    }
+
+    int minimum = -500, maximum = 500;
+    if (!normalize && !hid.getAxisRange(0, minimum, maximum))
+    {
+        std::cerr << "Unable to query the axis range." << std::endl;
+        return 1;
+    }
+    SpaceNavVirtualDevice output;
+    if (!output.create(*hid.getDeviceInfo(), minimum, maximum))
+    {
+        return 1;
+    }
+
+    Reemitter reemitter;
+    reemitter.output = &output;
+    reemitter.info = hid.getDeviceInfo();
+    reemitter.normalize = normalize;
+    reemitter.deadzone = deadzone;
+    reemitter.alpha = alpha;
+    memset(reemitter.emitted, 0, sizeof reemitter.emitted);
+    reemitter.first = true;
+    reemitter.frames = 0;
+    reemitter.suppressed = 0;
+    hid.subscribe<Reemitter, &Reemitter::onFrame>(SPACENAV_EVENT_FRAME, &reemitter);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    struct pollfd pfd[2];
+    pfd[0].fd = hid.getFileDescriptor();
+    pfd[0].events = POLLIN;
+    pfd[1].fd = output.getFileDescriptor();
+    pfd[1].events = POLLIN;
+
+    SpaceNavValues coordinates, raw;
+    unsigned long lastFrames = 0, lastEmitted = 0, lastSuppressed = 0;
+    long long statsStart = nowUs();
+    while (running)
+    {
+        const int ready = poll(pfd, 2, statistics ? 1000 : -1);
+        if (ready < 0)
+        {
+            continue;
+        }
+        if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            std::cerr << "Device is gone." << std::endl;
+            break;
+        }
+        if (pfd[0].revents & POLLIN)
+        {
+            hid.getValue(coordinates, raw);
+        }
+        // consumers switching the LED of the virtual device switch the real one.
+        int led;
+        if ((pfd[1].revents & POLLIN) && output.readLedState(led))
+        {
+            hid.setLedState(led);
+        }
+        if (statistics && nowUs() - statsStart >= 1000000)
+        {
+            statsStart = nowUs();
+            fprintf(stderr, "frames %lu  emitted %lu  suppressed %lu\n",
+                    reemitter.frames - lastFrames, output.getFrameCount() - lastEmitted, reemitter.suppressed - lastSuppressed);
+            lastFrames = reemitter.frames;
+            lastEmitted = output.getFrameCount();
+            lastSuppressed = reemitter.suppressed;
+        }
+    }
+
+    output.destroy();
+    hid.setExclusive(false);
+    hid.closeDevice();
+    return 0;
+}
@@ -0,0 +1,134 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "spacenav-shaper.hpp"
+#include "spacenav-hid.hpp"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace cosima::hw;
+
+/**
+ * Measures the cost of one SpaceNavShaper update (all six axes) under step
+ * changes of the targets, as they occur when the operator slams the cap.
+ */
+
+static long long nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    long cycles = 1000000;
+    double period = 0.001;
+    bool harden = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:rh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            cycles = atol(optarg);
+            break;
+        case 'p':
+            period = atof(optarg);
+            break;
+        case 'r':
+            harden = true;
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-n cycles] [-p period in s] [-r]\n"
+                      << "  -r  run with SCHED_FIFO and locked memory, otherwise the maximum includes preemption\n";
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (cycles <= 0 || period <= 0)
+    {
+        return 1;
+    }
+
+    if (harden)
+    {
+        // same hardening as the reading thread of the component.
+        SpaceNavHID hid;
+        if (!hid.hardenCurrentThread(SpaceNavRtOptions()).success())
+        {
+            std::cerr << "RT hardening failed, the maximum includes preemption." << std::endl;
+        }
+    }
+
+    SpaceNavShaper shaper;
+    for (int i = 0; i < 6; i++)
+    {
+        shaper.setLimits(i, i < 3 ? 0.25 : 1.0, i < 3 ? 1.0 : 4.0, i < 3 ? 10.0 : 40.0);
+    }
+
+    // the clock is read around every update, its own cost is measured and reported separately.
+    std::vector<long long> samples(cycles);
+    long long overhead = nowNs();
+    for (long c = 0; c < cycles; c++)
+    {
+        samples[c] = nowNs();
+    }
+    overhead = (nowNs() - overhead) / cycles;
+
+    double target[6] = {0, 0, 0, 0, 0, 0}, shaped[6];
+    double checksum = 0;
+    srand(1);
+    for (long c = 0; c < cycles; c++)
+    {
+        if (c % 97 == 0)
+        {
+            // full deflection steps, including reversals.
+            for (int i = 0; i < 6; i++)
+            {
+                target[i] = (rand() % 3 - 1) * (i < 3 ? 0.25 : 1.0);
+            }
+        }
+        const long long start = nowNs();
+        shaper.update(target, period, shaped);
+        samples[c] = nowNs() - start;
+        checksum += shaped[c % 6];
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const long long worst = samples.back();
+    printf("%ld updates of 6 axes, clock overhead %lld ns (included below)\n", cycles, overhead);
+    printf("p50 %lld ns  p99 %lld ns  p99.99 %lld ns  max %lld ns\n",
+           samples[cycles / 2], samples[cycles * 99 / 100], samples[cycles * 9999 / 10000], worst);
+    printf("p99.99 uses %.4f %%, the maximum %.4f %% of a %.3f ms cycle (checksum %g)\n",
+           100.0 * samples[cycles * 9999 / 10000] / (period * 1e9), 100.0 * worst / (period * 1e9), period * 1e3, checksum);
+    return 0;
+}
@@ -0,0 +1,290 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-uinput.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+
+using namespace cosima::hw;
+
+/**
+ * One scripted frame. A script holds one frame per line, separated by whitespace:
+ * "time_ms tx ty tz rx ry rz buttons", i.e. the offset from the first frame in ms,
+ * the raw axis values and the pressed buttons as decimal bit mask (bit n = button
+ * index n). A missing mask means no button, empty lines and lines starting with '#'
+ * are skipped.
+ */
+struct ScriptFrame
+{
+    double time_ms;
+    int axes[6];
+    SpaceNavButtons buttons;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int)
+{
+    running = 0;
+}
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "Creates a virtual 3Dconnexion device via uinput and replays motion on it.\n"
+              << "  -p vendor:product  device ids to report in hex (default 046d:c626)\n"
+              << "  -r rate            frames per second, 0 uses the script time stamps (default 250)\n"
+              << "  -t seconds         duration, 0 runs until interrupted (default 0)\n"
+              << "  -s file            replay the frames of a script or capture instead of synthetic motion\n"
+              << "                     (lines of: time_ms tx ty tz rx ry rz buttons)\n"
+              << "  -l                 loop the script\n"
+              << "  -a amplitude       amplitude of the synthetic motion (default 350)\n"
+              << "  -b bias            rest offset of the synthetic axes, with alternating sign (default 0)\n"
+              << "  -n sigma           standard deviation of the synthetic sensor noise (default 0)\n"
+              << "  -w seconds         wait before the first frame, to let consumers attach (default 1)\n";
+}
+
+static bool loadScript(const char *file, std::vector<ScriptFrame> &frames)
+{
+    std::ifstream in(file);
+    if (!in)
+    {
+        std::cerr << "Cannot open " << file << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream ls(line);
+        ScriptFrame frame;
+        unsigned long long buttons = 0;
+        ls >> frame.time_ms;
+        for (int i = 0; i < 6; i++)
+        {
+            double value = 0;
+            ls >> value;
+            frame.axes[i] = (int)lround(value);
+        }
+        ls >> buttons;
+        if (!ls.fail() || ls.eof())
+        {
+            frame.buttons.bits = buttons;
+            frames.push_back(frame);
+        }
+    }
+    return !frames.empty();
+}
+
+static long long nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void sleepUntil(const long long deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000LL;
+    ts.tv_nsec = deadline % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running)
+    {
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int vendor = 0x046d, product = 0xc626;
+    double rate = 250, duration = 0, amplitude = 350, bias = 0, noise = 0, wait = 1;
+    const char *script = NULL;
+    bool loop = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:r:t:s:la:b:n:w:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            if (sscanf(optarg, "%x:%x", &vendor, &product) != 2)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 't':
+            duration = atof(optarg);
+            break;
+        case 's':
+            script = optarg;
+            break;
+        case 'l':
+            loop = true;
+            break;
+        case 'a':
+            amplitude = atof(optarg);
+            break;
+        case 'b':
+            bias = atof(optarg);
+            break;
+        case 'n':
+            noise = atof(optarg);
+            break;
+        case 'w':
+            wait = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    const SpaceNavDeviceInfo *info = findDeviceInfo(vendor, product);
+    if (!info)
+    {
+        std::cerr << "Unknown device " << std::hex << vendor << ":" << product << std::endl;
+        return 1;
+    }
+
+    std::vector<ScriptFrame> frames;
+    if (script && !loadScript(script, frames))
+    {
+        return 1;
+    }
+    if (!script && rate <= 0)
+    {
+        std::cerr << "Synthetic motion needs a rate." << std::endl;
+        return 1;
+    }
+
+    SpaceNavVirtualDevice device;
+    if (!device.create(*info, -350, 350))
+    {
+        return 1;
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    // udev and the consumers need a moment to see the new device.
+    usleep((useconds_t)(wait * 1e6));
+
+    const long long period = rate > 0 ? (long long)(1e9 / rate) : 0;
+    const long long start = nowNs();
+    const long long end = duration > 0 ? start + (long long)(duration * 1e9) : 0;
+    long long scriptStart = start;
+    unsigned long late = 0, failed = 0;
+    size_t next = 0;
+    std::mt19937 generator(1);
+    std::normal_distribution<double> gaussian(0, noise > 0 ? noise : 1);
+
+    for (unsigned long n = 0; running; n++)
+    {
+        long long deadline;
+        int axes[6];
+        SpaceNavButtons buttons;
+
+        if (script)
+        {
+            if (next == frames.size())
+            {
+                if (!loop)
+                {
+                    break;
+                }
+                next = 0;
+                scriptStart = nowNs();
+            }
+            const ScriptFrame &frame = frames[next++];
+            deadline = period > 0 ? start + n * period : scriptStart + (long long)(frame.time_ms * 1e6);
+            for (int i = 0; i < 6; i++)
+            {
+                axes[i] = frame.axes[i];
+            }
+            buttons = frame.buttons;
+        }
+        else
+        {
+            deadline = start + n * period;
+            const double t = (deadline - start) * 1e-9;
+            for (int i = 0; i < 6; i++)
+            {
+                // a worn device rests off center, -a 0 -b 200 -n 3 models one at rest.
+                double value = amplitude * sin(2 * M_PI * 0.5 * t + i * M_PI / 3) + (i % 2 ? -bias : bias);
+                value += noise > 0 ? gaussian(generator) : 0;
+                axes[i] = (int)lround(value < -350 ? -350 : (value > 350 ? 350 : value));
+            }
+            // short press of button 0 every second, button 1 half a second later.
+            const double phase = fmod(t, 1.0);
+            buttons.set(0, phase < 0.05);
+            buttons.set(1, phase >= 0.5 && phase < 0.55);
+        }
+
+        if (end && deadline >= end)
+        {
+            break;
+        }
+
+        // when falling behind, emit immediately to catch up.
+        if (deadline > nowNs())
+        {
+            sleepUntil(deadline);
+        }
+        else if (n > 0)
+        {
+            late++;
+        }
+
+        if (!device.emitFrame(axes, buttons))
+        {
+            failed++;
+        }
+    }
+
+    const double elapsed = (nowNs() - start) * 1e-9;
+    std::cout << "Emitted " << device.getFrameCount() << " frames in " << elapsed << " s ("
+              << device.getFrameCount() / elapsed << " frames/s), " << late << " late, " << failed << " failed" << std::endl;
+
+    device.destroy();
+    return 0;
+}
@@ -0,0 +1,500 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-hid.hpp"
+#include "spacenav-uinput.hpp"
+#include "spacenav-latency.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <math.h>
+#include <sys/resource.h>
+
+#ifdef SPACENAV_SOAK_COMPONENT
+#include "orocos/spacenav-orocos.hpp"
+#include <rtt/extras/FileDescriptorActivity.hpp>
+#include <sys/syscall.h>
+#endif
+
+using namespace cosima::hw;
+
+/**
+ * Soak and stress harness: drives the library (or the component) through a
+ * virtual device at increasing event rates and reports the cost per rate.
+ */
+
+static long long nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static double toSeconds(const struct timeval &tv)
+{
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static long residentKb()
+{
+    long pages = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+struct StageResult
+{
+    double rate;
+    double seconds;
+    unsigned long emitted;
+    unsigned long outputs;
+    unsigned long wakeups;
+    unsigned long dropped;
+    double cpu;
+    long nvcsw;
+    long nivcsw;
+    long rssStart;
+    long rssEnd;
+    SpaceNavLatencyHistogram latency;
+};
+
+/**
+ * Emits synthetic frames at rate until duration passes and reports its own cpu time.
+ */
+static void generate(SpaceNavVirtualDevice *device, const double rate, const double duration,
+                     std::atomic<bool> *done, double *cpu)
+{
+    const long long period = (long long)(1e9 / rate);
+    const long long start = nowNs();
+    const long long end = start + (long long)(duration * 1e9);
+    for (unsigned long n = 0;; n++)
+    {
+        const long long deadline = start + n * period;
+        if (deadline >= end)
+        {
+            break;
+        }
+        const double t = (deadline - start) * 1e-9;
+        int axes[6];
+        for (int i = 0; i < 6; i++)
+        {
+            axes[i] = (int)lround(350 * sin(2 * M_PI * 0.5 * t + i * M_PI / 3));
+        }
+        SpaceNavButtons buttons;
+        buttons.set(0, fmod(t, 1.0) < 0.05);
+        if (deadline > nowNs())
+        {
+            struct timespec ts;
+            ts.tv_sec = deadline / 1000000000LL;
+            ts.tv_nsec = deadline % 1000000000LL;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        device->emitFrame(axes, buttons);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    *cpu = toSeconds(usage.ru_utime) + toSeconds(usage.ru_stime);
+    done->store(true);
+}
+
+static void runLibraryStage(SpaceNavHID &hid, SpaceNavVirtualDevice &device, StageResult &result, const double duration)
+{
+    SpaceNavValues coordinates, raw;
+    struct pollfd pfd;
+    pfd.fd = hid.getFileDescriptor();
+    pfd.events = POLLIN;
+
+    const unsigned long emittedStart = device.getFrameCount();
+    const unsigned long droppedStart = hid.getDroppedCount();
+    long long lastStamp = 0;
+    struct rusage before, after;
+    getrusage(RUSAGE_THREAD, &before);
+    result.rssStart = residentKb();
+    const long long start = nowNs();
+
+    std::atomic<bool> done(false);
+    double generatorCpu = 0;
+    std::thread generator(generate, &device, result.rate, duration, &done, &generatorCpu);
+
+    while (!done.load() || poll(&pfd, 1, 0) > 0)
+    {
+        if (poll(&pfd, 1, 100) <= 0)
+        {
+            continue;
+        }
+        result.wakeups++;
+        hid.getValue(coordinates, raw);
+        if (raw.timestamp != lastStamp)
+        {
+            lastStamp = raw.timestamp;
+            result.outputs++;
+            result.latency.add(nowNs() / 1000 - raw.timestamp);
+        }
+        SpaceNavButtonEvent event;
+        while (hid.popButtonEvent(event))
+        {
+        }
+    }
+    generator.join();
+
+    result.seconds = (nowNs() - start) * 1e-9;
+    getrusage(RUSAGE_THREAD, &after);
+    result.rssEnd = residentKb();
+    result.cpu = toSeconds(after.ru_utime) + toSeconds(after.ru_stime) - toSeconds(before.ru_utime) - toSeconds(before.ru_stime);
+    result.nvcsw = after.ru_nvcsw - before.ru_nvcsw;
+    result.nivcsw = after.ru_nivcsw - before.ru_nivcsw;
+    result.emitted = device.getFrameCount() - emittedStart;
+    result.dropped = hid.getDroppedCount() - droppedStart;
+}
+
+#ifdef SPACENAV_SOAK_COMPONENT
+/**
+ * Counts the wake-ups of the activity and remembers its thread, the process wide
+ * counters also hold the generator and the sampling thread.
+ */
+class SoakComponent : public SpaceNavOrocos
+{
+public:
+    SoakComponent() : SpaceNavOrocos("soak"),
+                      updates(0),
+                      thread(0)
+    {
+    }
+
+    void updateHook()
+    {
+        if (thread.load(std::memory_order_relaxed) == 0)
+        {
+            thread.store(syscall(SYS_gettid), std::memory_order_relaxed);
+        }
+        SpaceNavOrocos::updateHook();
+        updates.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<unsigned long> updates;
+    std::atomic<long> thread;
+};
+
+/**
+ * Context switches of a thread of this process, false if it is unknown.
+ */
+static bool threadSwitches(const long thread, long &voluntary, long &involuntary)
+{
+    voluntary = involuntary = 0;
+    if (thread == 0)
+    {
+        return false;
+    }
+    std::ostringstream path;
+    path << "/proc/self/task/" << thread << "/status";
+    std::ifstream status(path.str().c_str());
+    std::string key;
+    int found = 0;
+    while (status >> key)
+    {
+        if (key == "voluntary_ctxt_switches:")
+        {
+            found += (status >> voluntary) ? 1 : 0;
+        }
+        else if (key == "nonvoluntary_ctxt_switches:")
+        {
+            found += (status >> involuntary) ? 1 : 0;
+        }
+    }
+    return found == 2;
+}
+
+static void runComponentStage(SoakComponent &component, SpaceNavVirtualDevice &device, StageResult &result, const double duration)
+{
+    RTT::InputPort<Eigen::VectorXf> sink("soak_sink");
+    sink.connectTo(component.getPort("out_6d_port"), RTT::ConnPolicy::buffer(1024));
+    Eigen::VectorXf sample(6);
+
+    const unsigned long emittedStart = device.getFrameCount();
+    // one wake-up to learn the activity thread before the first stage.
+    for (int i = 0; i < 100 && component.thread.load() == 0; i++)
+    {
+        component.trigger();
+        usleep(10000);
+    }
+    const unsigned long updatesStart = component.updates.load();
+    long nvcswStart = 0, nivcswStart = 0;
+    const bool known = threadSwitches(component.thread.load(), nvcswStart, nivcswStart);
+    struct rusage before, after, self;
+    getrusage(RUSAGE_SELF, &before);
+    getrusage(RUSAGE_THREAD, &self);
+    const double selfStart = toSeconds(self.ru_utime) + toSeconds(self.ru_stime);
+    result.rssStart = residentKb();
+    const long long start = nowNs();
+
+    std::atomic<bool> done(false);
+    double generatorCpu = 0;
+    std::thread generator(generate, &device, result.rate, duration, &done, &generatorCpu);
+
+    // the component runs in its FileDescriptorActivity, only count what arrives.
+    while (!done.load())
+    {
+        usleep(10000);
+        while (sink.read(sample) == RTT::NewData)
+        {
+            result.outputs++;
+        }
+    }
+    generator.join();
+    usleep(100000);
+    while (sink.read(sample) == RTT::NewData)
+    {
+        result.outputs++;
+    }
+
+    result.seconds = (nowNs() - start) * 1e-9;
+    getrusage(RUSAGE_SELF, &after);
+    getrusage(RUSAGE_THREAD, &self);
+    result.rssEnd = residentKb();
+    // process time without the generator and this sampling thread.
+    result.cpu = toSeconds(after.ru_utime) + toSeconds(after.ru_stime) - toSeconds(before.ru_utime) - toSeconds(before.ru_stime) - generatorCpu - (toSeconds(self.ru_utime) + toSeconds(self.ru_stime) - selfStart);
+    // the activity thread only, it wakes up once per updateHook.
+    result.wakeups = component.updates.load() - updatesStart;
+    long nvcswEnd = 0, nivcswEnd = 0;
+    if (known && threadSwitches(component.thread.load(), nvcswEnd, nivcswEnd))
+    {
+        result.nvcsw = nvcswEnd - nvcswStart;
+        result.nivcsw = nivcswEnd - nivcswStart;
+    }
+    else
+    {
+        // the activity thread is unknown or gone.
+        result.nvcsw = -1;
+        result.nivcsw = -1;
+    }
+    result.emitted = device.getFrameCount() - emittedStart;
+    result.dropped = 0;
+    sink.disconnect();
+}
+#endif
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "Drives the driver through a virtual device (needs /dev/uinput) and reports the cost per event rate.\n"
+              << "  -r r1,r2,...  frame rates to run (default 100,250,1000,4000,10000,20000)\n"
+              << "  -t seconds    duration of each rate (default 10)\n"
+              << "  -c cycles     closeDevice/initDevice cycles to check for leaks (default 100)\n"
+              << "  -o file       also write the report as CSV\n"
+#ifdef SPACENAV_SOAK_COMPONENT
+              << "  -m            drive the SpaceNavOrocos component instead of the library\n"
+#endif
+        ;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<double> rates;
+    double duration = 10;
+    int cycles = 100;
+    const char *csv = NULL;
+    bool component = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:t:c:o:mh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+        {
+            std::istringstream list(optarg);
+            std::string rate;
+            while (std::getline(list, rate, ','))
+            {
+                rates.push_back(atof(rate.c_str()));
+            }
+            break;
+        }
+        case 't':
+            duration = atof(optarg);
+            break;
+        case 'c':
+            cycles = atoi(optarg);
+            break;
+        case 'o':
+            csv = optarg;
+            break;
+#ifdef SPACENAV_SOAK_COMPONENT
+        case 'm':
+            component = true;
+            break;
+#endif
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (rates.empty())
+    {
+        const double defaults[] = {100, 250, 1000, 4000, 10000, 20000};
+        rates.assign(defaults, defaults + 6);
+    }
+
+    SpaceNavVirtualDevice device;
+    if (!device.create(*findDeviceInfo(0x046d, 0xc626), -350, 350))
+    {
+        return 1;
+    }
+    // let udev create the node.
+    usleep(500000);
+
+    // the driver is chatty while opening the device.
+    std::ofstream devnull("/dev/null");
+    std::streambuf *out = std::cout.rdbuf(devnull.rdbuf());
+
+    SpaceNavHID hid;
+#ifdef SPACENAV_SOAK_COMPONENT
+    SoakComponent sn;
+    RTT::extras::FileDescriptorActivity activity(0, 0);
+    if (component)
+    {
+        sn.setActivity(&activity);
+    }
+#endif
+
+    /* ###################### RECONFIGURE CYCLES ###################### */
+    long rssCyclesStart = residentKb();
+    int failedCycles = 0;
+    for (int i = 0; i < cycles; i++)
+    {
+#ifdef SPACENAV_SOAK_COMPONENT
+        if (component)
+        {
+            failedCycles += sn.configure() ? 0 : 1;
+            sn.cleanup();
+            continue;
+        }
+#endif
+        failedCycles += hid.initDevice() ? 0 : 1;
+        hid.closeDevice();
+    }
+    long rssCyclesEnd = residentKb();
+
+    bool ready;
+#ifdef SPACENAV_SOAK_COMPONENT
+    ready = component ? (sn.configure() && sn.start()) : hid.initDevice();
+#else
+    ready = hid.initDevice();
+#endif
+    std::cout.rdbuf(out);
+    if (!ready)
+    {
+        std::cerr << "Unable to open the virtual device." << std::endl;
+        return 1;
+    }
+    if (!component && hid.getDeviceInfo()->product != 0xc626)
+    {
+        std::cerr << "Warning: opened " << hid.getDeviceInfo()->name << " instead of the virtual device." << std::endl;
+    }
+
+    std::cout << "Reconfigure cycles: " << cycles << ", failed " << failedCycles << ", RSS " << rssCyclesStart << " kB -> " << rssCyclesEnd << " kB";
+    if (cycles > 0)
+    {
+        std::cout << " (" << (rssCyclesEnd - rssCyclesStart) * 1024.0 / cycles << " bytes/cycle)";
+    }
+    std::cout << std::endl;
+
+    /* ###################### RATE STAGES ###################### */
+    std::vector<StageResult *> results;
+    std::cout << std::setw(8) << "rate" << std::setw(10) << "emitted" << std::setw(10) << "outputs" << std::setw(10) << "wakeup/s"
+              << std::setw(9) << "cpu %" << std::setw(10) << "cpu/out" << std::setw(9) << "vcsw" << std::setw(9) << "ivcsw"
+              << std::setw(8) << "dropped" << std::setw(10) << "rss kB" << std::setw(8) << "p50 us" << std::setw(8) << "p99 us" << std::setw(8) << "max us" << std::endl;
+    for (size_t i = 0; i < rates.size(); i++)
+    {
+        StageResult *result = new StageResult();
+        result->rate = rates[i];
+#ifdef SPACENAV_SOAK_COMPONENT
+        if (component)
+        {
+            runComponentStage(sn, device, *result, duration);
+        }
+        else
+#endif
+        {
+            runLibraryStage(hid, device, *result, duration);
+        }
+        results.push_back(result);
+
+        std::cout << std::setw(8) << result->rate << std::setw(10) << result->emitted << std::setw(10) << result->outputs
+                  << std::setw(10) << std::fixed << std::setprecision(0) << result->wakeups / result->seconds
+                  << std::setw(9) << std::setprecision(2) << 100.0 * result->cpu / result->seconds
+                  << std::setw(10) << std::setprecision(2) << (result->outputs ? 1e6 * result->cpu / result->outputs : 0.0)
+                  << std::setw(9) << result->nvcsw << std::setw(9) << result->nivcsw << std::setw(8) << result->dropped
+                  << std::setw(10) << (std::to_string(result->rssEnd - result->rssStart) + (result->rssEnd > result->rssStart ? "+" : ""))
+                  << std::setw(8) << result->latency.percentile(0.5) << std::setw(8) << result->latency.percentile(0.99) << std::setw(8) << result->latency.max
+                  << std::endl;
+    }
+    std::cout << "cpu/out in us per output, rss as growth during the stage. Latency is only measured for the library." << std::endl;
+
+    if (csv)
+    {
+        std::ofstream file(csv);
+        file << "rate,seconds,emitted,outputs,wakeups,cpu_s,nvcsw,nivcsw,dropped,rss_start_kb,rss_end_kb,latency_p50_us,latency_p99_us,latency_max_us\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const StageResult &r = *results[i];
+            file << r.rate << "," << r.seconds << "," << r.emitted << "," << r.outputs << "," << r.wakeups << "," << r.cpu << ","
+                 << r.nvcsw << "," << r.nivcsw << "," << r.dropped << "," << r.rssStart << "," << r.rssEnd << ","
+                 << r.latency.percentile(0.5) << "," << r.latency.percentile(0.99) << "," << r.latency.max << "\n";
+        }
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        delete results[i];
+    }
+#ifdef SPACENAV_SOAK_COMPONENT
+    if (component)
+    {
+        sn.stop();
+        sn.cleanup();
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,149 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-trace.hpp"
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace cosima::hw;
+
+/**
+ * Decodes flight recorder files written by SPACENAV_TRACE, also after a crash.
+ * Records of several threads are merged by time.
+ */
+
+struct Entry
+{
+    SpaceNavTraceRecord record;
+    int tid;
+};
+
+static bool byTime(const Entry &a, const Entry &b)
+{
+    return a.record.time < b.record.time;
+}
+
+static bool load(const char *file, std::vector<Entry> &entries)
+{
+    FILE *in = fopen(file, "rb");
+    if (!in)
+    {
+        perror(file);
+        return false;
+    }
+    SpaceNavTraceHeader header;
+    if (fread(&header, sizeof header, 1, in) != 1 || header.magic != SPACENAV_TRACE_MAGIC ||
+        header.version != SPACENAV_TRACE_VERSION || header.recordSize != sizeof(SpaceNavTraceRecord) ||
+        header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0)
+    {
+        fprintf(stderr, "%s: not a trace file\n", file);
+        fclose(in);
+        return false;
+    }
+    std::vector<SpaceNavTraceRecord> records(header.capacity);
+    const size_t count = fread(&records[0], sizeof(SpaceNavTraceRecord), header.capacity, in);
+    fclose(in);
+
+    // the oldest record follows the newest one in the ring.
+    const uint64_t written = header.written;
+    const uint64_t first = written > header.capacity ? written - header.capacity : 0;
+    for (uint64_t i = first; i < written; i++)
+    {
+        const SpaceNavTraceRecord &record = records[i & (header.capacity - 1)];
+        // a record torn by the crash carries the sequence of the previous round.
+        if ((i & (header.capacity - 1)) >= count || record.sequence != (uint32_t)i)
+        {
+            continue;
+        }
+        Entry entry;
+        entry.record = record;
+        entry.tid = header.tid;
+        entries.push_back(entry);
+    }
+    printf("# %s: pid %d tid %d, %llu records written\n", file, header.pid, header.tid, (unsigned long long)written);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t last = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            last = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n last_records] /dev/shm/spacenav-trace.<pid>.<tid> ...\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: %s [-n last_records] /dev/shm/spacenav-trace.<pid>.<tid> ...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Entry> entries;
+    for (int i = optind; i < argc; i++)
+    {
+        load(argv[i], entries);
+    }
+    if (entries.empty())
+    {
+        return 1;
+    }
+    std::stable_sort(entries.begin(), entries.end(), byTime);
+
+    const size_t begin = last && last < entries.size() ? entries.size() - last : 0;
+    const uint64_t end = entries.back().record.time;
+    printf("# time relative to the last record in ms\n");
+    printf("# %12s %8s %10s %-12s %12s %12s %12s %12s\n", "t_ms", "tid", "seq", "stage", "v0", "v1", "v2", "v3");
+    for (size_t i = begin; i < entries.size(); i++)
+    {
+        const SpaceNavTraceRecord &r = entries[i].record;
+        printf("%14.6f %8d %10u %-12s", -(double)(end - r.time) * 1e-6, entries[i].tid, r.sequence, spacenavTraceStageName(r.stage));
+        for (int v = 0; v < 4; v++)
+        {
+            if ((r.integers >> v) & 1)
+            {
+                printf(" %12lld", (long long)r.values[v].integer);
+            }
+            else
+            {
+                printf(" %12g", r.values[v].real);
+            }
+        }
+        printf("\n");
+    }
+    return 0;
+}
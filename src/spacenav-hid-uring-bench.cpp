@@ -0,0 +1,183 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-uring.hpp"
+#include <linux/input.h>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+using namespace cosima::hw;
+
+/**
+ * Compares the read() path with the io_uring reader. Every device is a pipe
+ * fed with synthetic frames, so the numbers contain the collection cost only.
+ */
+
+static long long nowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+struct Result
+{
+    double nsPerRound;
+    double waitsPerRound;
+    unsigned long frames;
+};
+
+static bool run(const bool useUring, const int numDevices, const int framesPerRound, const int rounds, Result &result)
+{
+    std::vector<SpaceNavHID *> hids;
+    std::vector<int> writers;
+    SpaceNavUringReader reader;
+    for (int i = 0; i < numDevices; i++)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+        {
+            return false;
+        }
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        SpaceNavHID *hid = new SpaceNavHID();
+        hid->attachDescriptor(fds[0], findDeviceInfo(0x046d, 0xc626));
+        hids.push_back(hid);
+        writers.push_back(fds[1]);
+        reader.addDevice(hid);
+    }
+    if (!reader.start(useUring) || reader.isUsingUring() != useUring)
+    {
+        return false;
+    }
+
+    // one frame: all six axes and the report.
+    std::vector<struct input_event> frames(7 * framesPerRound);
+    memset(&frames[0], 0, frames.size() * sizeof(struct input_event));
+
+    long long elapsed = 0;
+    const unsigned long waitsStart = reader.getWaitCount();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int f = 0; f < framesPerRound; f++)
+        {
+            for (int a = 0; a < 6; a++)
+            {
+                frames[f * 7 + a].type = EV_ABS;
+                frames[f * 7 + a].code = ABS_X + a;
+                frames[f * 7 + a].value = (round + f + a) % 700 - 350;
+            }
+            frames[f * 7 + 6].type = EV_SYN;
+            frames[f * 7 + 6].code = SYN_REPORT;
+        }
+        for (int i = 0; i < numDevices; i++)
+        {
+            if (write(writers[i], &frames[0], frames.size() * sizeof(struct input_event)) < 0)
+            {
+                return false;
+            }
+        }
+
+        const long long start = nowNs();
+        int updated = 0;
+        while (updated < numDevices)
+        {
+            const int updates = reader.update(1000);
+            if (updates < 0)
+            {
+                return false;
+            }
+            updated += updates;
+        }
+        elapsed += nowNs() - start;
+    }
+
+    result.nsPerRound = (double)elapsed / rounds;
+    result.waitsPerRound = (double)(reader.getWaitCount() - waitsStart) / rounds;
+    result.frames = 0;
+    reader.stop();
+    for (int i = 0; i < numDevices; i++)
+    {
+        // without the snapshot taken when attaching.
+        result.frames += hids[i]->getFrameCount() - 1;
+        delete hids[i];
+        close(writers[i]);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int numDevices = 4, framesPerRound = 1, rounds = 100000;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:f:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            numDevices = atoi(optarg);
+            break;
+        case 'f':
+            framesPerRound = atoi(optarg);
+            break;
+        case 'n':
+            rounds = atoi(optarg);
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-d devices (max " << SpaceNavUringReader::MAX_DEVICES << ")] [-f frames per round] [-n rounds]" << std::endl;
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (numDevices < 1 || numDevices > SpaceNavUringReader::MAX_DEVICES || framesPerRound < 1 || framesPerRound > 9)
+    {
+        std::cerr << "Between 1 and " << SpaceNavUringReader::MAX_DEVICES << " devices and 1 to 9 frames per round (one read)." << std::endl;
+        return 1;
+    }
+
+    printf("%d devices, %d frames per device and round, %d rounds\n", numDevices, framesPerRound, rounds);
+    printf("%-10s %14s %16s %16s %12s\n", "path", "ns/round", "ns/device", "syscalls/round", "frames");
+    Result read, uring;
+    if (run(false, numDevices, framesPerRound, rounds, read))
+    {
+        // poll() plus one read() per device.
+        printf("%-10s %14.0f %16.0f %16.2f %12lu\n", "read", read.nsPerRound, read.nsPerRound / numDevices, read.waitsPerRound + numDevices, read.frames);
+    }
+    if (run(true, numDevices, framesPerRound, rounds, uring))
+    {
+        printf("%-10s %14.0f %16.0f %16.2f %12lu\n", "io_uring", uring.nsPerRound, uring.nsPerRound / numDevices, uring.waitsPerRound, uring.frames);
+    }
+    else
+    {
+        printf("io_uring is not available on this host.\n");
+    }
+    return 0;
+}
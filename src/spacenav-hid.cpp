@@ -44,6 +44,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // Code from https://github.com/FreeSpacenav/spacenavd/blob/master/src/dev_usb_linux.c
 
 #include "spacenav-hid.hpp"
+#include "spacenav-trace.hpp"
 
 #include <linux/input.h>
 #include <linux/limits.h>
@@ -57,6 +58,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <fstream>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 
 #ifndef XENOMAI_VERSION_MAJOR
 
@@ -90,6 +98,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define DEF_MAXVAL 500
 #define DEF_RANGE (DEF_MAXVAL - DEF_MINVAL)
 
+// Older kernel headers do not provide the accessors for the event time stamp.
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
 // #define VENDOR_ID    0x046d
 // #define PRODUCT_ID   0xc626
 using namespace std;
@@ -100,14 +114,41 @@ namespace cosima
 namespace hw
 {
 
-SpaceNavHID::SpaceNavHID()
+SpaceNavHID::SpaceNavHID() : fd(-1),
+                             mode(0),
+                             num_axes(0),
+                             device(NULL),
+                             buttonEventOverflows(0),
+                             subscribedMask(0),
+                             history(NULL),
+                             opened(false),
+                             virtualDevicesAllowed(true),
+                             pendingCalibrationValid(false),
+                             calibrationVersion(0),
+                             calibrated(false),
+                             calibrationSeen(0),
+                             majorFaultsAtHardening(-1),
+                             minorFaultsAtHardening(-1),
+                             dropping(false),
+                             droppedCount(0),
+                             frameCount(0),
+                             absinfo(NULL)
 {
   oldValues.reset();
+  pendingValues.reset();
+  for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+  {
+    subscribers[i].mask = 0;
+    subscribers[i].callback = NULL;
+    subscribers[i].context = NULL;
+  }
 }
 
 SpaceNavHID::~SpaceNavHID()
 {
   closeDevice();
+  delete[] absinfo;
+  delete history;
 }
 
 int SpaceNavHID::getFileDescriptor()
@@ -115,15 +156,65 @@ int SpaceNavHID::getFileDescriptor()
   return fd;
 }
 
-bool SpaceNavHID::initDevice()
+void SpaceNavHID::resetState()
 {
-  btn_0_pressed = false;
-  btn_1_pressed = false;
+  // a reconfiguration must not leak the previous device.
+  closeDevice();
+  toggles.reset();
+  device = NULL;
+  availableButtons.reset();
+  buttonEvents.clear();
+  buttonEventOverflows = 0;
+  dropping = false;
+  droppedCount = 0;
+  frameCount = 0;
   mode = 0;
+  oldValues.reset();
+  pendingValues.reset();
+}
+
+bool SpaceNavHID::attachDescriptor(const int descriptor, const SpaceNavDeviceInfo *info)
+{
+  resetState();
+  if (descriptor < 0 || !info)
+  {
+    return false;
+  }
+  fd = descriptor;
+  device = info;
+  num_axes = info->numAxes;
+
+  delete[] absinfo;
+  absinfo = new input_absinfo_td[num_axes < 6 ? 6 : num_axes];
+  for (int i = 0; i < (num_axes < 6 ? 6 : num_axes); i++)
+  {
+    absinfo[i].minimum = DEF_MINVAL;
+    absinfo[i].maximum = DEF_MAXVAL;
+    absinfo[i].fuzz = 0;
+    // keeps the defaults if the descriptor is not an evdev device.
+    rt_dev_ioctl(fd, EVIOCGABS(ABS_X + i), &(absinfo[i]));
+  }
+
+  queryButtons();
+  resynchronize();
+  toggles.reset();
+  buttonEvents.clear();
+  if (opened)
+  {
+    metrics.add(SPACENAV_METRIC_RECONNECTS);
+  }
+  opened = true;
+  return true;
+}
+
+bool SpaceNavHID::initDevice()
+{
+  resetState();
   struct dirent *entry;
   DIR *dp;
 
   input_id_td device_info;
+  memset(&device_info, 0, sizeof device_info);
 
   std::string devDirectory = "/dev/input/";
   std::string path = devDirectory;
@@ -135,12 +226,12 @@ bool SpaceNavHID::initDevice()
   fd = rt_dev_open(dev_event_file_name, O_RDWR | O_NONBLOCK);
   std::cout << "fd = " << fd << std::endl;
   std::cout << "checkDeviceId(fd, device_info) = " << checkDeviceId(fd, device_info) << std::endl;
-  if ((fd > -1) && checkDeviceId(fd, device_info))
+  if ((fd > -1) && checkDeviceId(fd, device_info) && (virtualDevicesAllowed ? isVirtual(fd) : isAvailable(fd)))
   {
     std::cout << "[SpaceNavHID] "
               << "Using evdev device: " << dev_event_file_name << std::endl;
     rt_dev_close(fd);
-    mode = determineDeviceMode(dev_event_file_name);
+    mode = determineDeviceMode(dev_event_file_name, fd);
     if (mode == -1)
     {
       std::cerr << "[SpaceNavHID] "
@@ -150,6 +241,11 @@ bool SpaceNavHID::initDevice()
   }
   else
   {
+    if (fd > -1)
+    {
+      rt_dev_close(fd);
+      fd = -1;
+    }
     /* open the directory */
     std::cout << "[SpaceNavHID] "
               << "Searching for a suitable device in " << devDirectory << std::endl;
@@ -161,6 +257,9 @@ bool SpaceNavHID::initDevice()
       return false;
     }
 
+    // first physical match, used if there is no virtual one.
+    std::string fallback;
+
     /* walk the directory (non-recursively) */
     while ((entry = readdir(dp)))
     {
@@ -180,9 +279,27 @@ bool SpaceNavHID::initDevice()
 
       if (checkDeviceId(fd, device_info))
       {
-        std::cout << "[SpaceNavHID] "
-                  << "Vendor and ID do match! " << std::endl;
-        break;
+        if (virtualDevicesAllowed ? isVirtual(fd) : isAvailable(fd))
+        {
+          std::cout << "[SpaceNavHID] "
+                    << "Vendor and ID do match! " << std::endl;
+          break;
+        }
+        if (virtualDevicesAllowed)
+        {
+          // while a re-emitter runs the physical device is grabbed, its virtual device delivers.
+          fallback = fallback.empty() ? path : fallback;
+          std::cout << "[SpaceNavHID] "
+                    << "Vendor and ID do match, but a virtual device is preferred." << std::endl;
+        }
+        else
+        {
+          std::cout << "[SpaceNavHID] "
+                    << "Vendor and ID do match, but the device is grabbed or virtual." << std::endl;
+        }
+        rt_dev_close(fd);
+        fd = -1;
+        continue;
       }
       std::cout << "[SpaceNavHID] "
                 << "Vendor and ID do not match." << std::endl;
@@ -191,6 +308,14 @@ bool SpaceNavHID::initDevice()
     }
     closedir(dp);
 
+    if (fd == -1 && !fallback.empty())
+    {
+      path = fallback;
+      fd = rt_dev_open(path.c_str(), O_RDONLY | O_NONBLOCK);
+      std::cout << "[SpaceNavHID] "
+                << "No virtual device, using " << path << std::endl;
+    }
+
     if (fd == -1)
     {
       std::cerr << "[SpaceNavHID] "
@@ -199,15 +324,18 @@ bool SpaceNavHID::initDevice()
     }
     // needed for the next checks.
     rt_dev_close(fd);
-    mode = determineDeviceMode(dev_event_file_name);
+    mode = determineDeviceMode(path.c_str(), fd);
     if (mode == -1)
     {
       std::cerr << "[SpaceNavHID] "
-                << "No operating modes available for " << dev_event_file_name << std::endl;
+                << "No operating modes available for " << path << std::endl;
       return false;
     }
   }
 
+  std::cout << "[SpaceNavHID] "
+            << "Found " << device->name << " with " << device->numButtons << " buttons" << (device->hasLed ? " and LED" : "") << std::endl;
+
   /* ###################### NUMBER OF AXIS ###################### */
   num_axes = 6;
   std::cout << "[SpaceNavHID] "
@@ -243,9 +371,12 @@ bool SpaceNavHID::initDevice()
 
   /* ###################### MAX AND MIN VALUES ###################### */
   // if the device is an absolute device, find the minimum and maximum axis values
-  absinfo = new input_absinfo_td[num_axes];
+  // the scaling always addresses the six axes of the device table.
+  const int num_absinfo = num_axes < 6 ? 6 : num_axes;
+  delete[] absinfo;
+  absinfo = new input_absinfo_td[num_absinfo];
 
-  for (int i = 0; i < num_axes; i++)
+  for (int i = 0; i < num_absinfo; i++)
   {
     absinfo[i].minimum = DEF_MINVAL;
     absinfo[i].maximum = DEF_MAXVAL;
@@ -274,20 +405,460 @@ bool SpaceNavHID::initDevice()
     std::cout << "[SpaceNavHID] "
               << "Axis RX ABS range: [ " << absinfo[3].minimum << " - " << absinfo[3].maximum << " ] at " << absinfo[3].fuzz << std::endl;
   }
-  if (rt_dev_ioctl(fd, EVIOCGABS(ABS_RX), &(absinfo[4])) == 0)
+  if (rt_dev_ioctl(fd, EVIOCGABS(ABS_RY), &(absinfo[4])) == 0)
   {
     std::cout << "[SpaceNavHID] "
               << "Axis RY ABS range: [ " << absinfo[4].minimum << " - " << absinfo[4].maximum << " ] at " << absinfo[4].fuzz << std::endl;
   }
-  if (rt_dev_ioctl(fd, EVIOCGABS(ABS_RX), &(absinfo[5])) == 0)
+  if (rt_dev_ioctl(fd, EVIOCGABS(ABS_RZ), &(absinfo[5])) == 0)
   {
     std::cout << "[SpaceNavHID] "
               << "Axis RZ ABS range: [ " << absinfo[5].minimum << " - " << absinfo[5].maximum << " ] at " << absinfo[5].fuzz << std::endl;
   }
 
+  // stamp the events with the same clock as the rest of the system.
+  int clock_id = CLOCK_MONOTONIC;
+  rt_dev_ioctl(fd, EVIOCSCLOCKID, &clock_id);
+
+  queryButtons();
+
+  /* ###################### INITIAL STATE ###################### */
+  // start with the values the device currently reports instead of zero.
+  if (!resynchronize())
+  {
+    std::cerr << "[SpaceNavHID] "
+              << "Unable to read the initial device state, starting at zero." << std::endl;
+  }
+  // buttons held while opening are neither toggles nor edges.
+  toggles.reset();
+  buttonEvents.clear();
+
+  if (opened)
+  {
+    metrics.add(SPACENAV_METRIC_RECONNECTS);
+  }
+  opened = true;
   return true;
 }
 
+void SpaceNavHID::queryButtons()
+{
+  availableButtons.reset();
+  unsigned char key_mask[(KEY_MAX + 7) / 8];
+  memset(key_mask, 0, sizeof key_mask);
+  const bool queried = rt_dev_ioctl(fd, EVIOCGBIT(EV_KEY, sizeof key_mask), key_mask) >= 0;
+  for (int i = 0; i < getNumButtons(); i++)
+  {
+    const int code = buttonIndexToCode(i);
+    availableButtons.set(i, code >= 0 && (!queried || ((key_mask[code / 8] >> (code % 8)) & 1)));
+  }
+  if (queried && !availableButtons.any())
+  {
+    // e.g. a pipe or a device with a different key mapping.
+    for (int i = 0; i < getNumButtons(); i++)
+    {
+      availableButtons.set(i, buttonIndexToCode(i) >= 0);
+    }
+  }
+  else if (queried && __builtin_popcountll(availableButtons.bits) < getNumButtons())
+  {
+    std::cout << "[SpaceNavHID] "
+              << "The device reports " << __builtin_popcountll(availableButtons.bits) << " of " << getNumButtons() << " buttons." << std::endl;
+  }
+}
+
+bool SpaceNavHID::resynchronize()
+{
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  SpaceNavValues snapshot = oldValues;
+  double *axes[6] = {&snapshot.tx, &snapshot.ty, &snapshot.tz, &snapshot.rx, &snapshot.ry, &snapshot.rz};
+  bool success = true;
+
+  for (int i = 0; i < 6 && i < num_axes; i++)
+  {
+    input_absinfo_td info;
+    if (rt_dev_ioctl(fd, EVIOCGABS(ABS_X + i), &info) == 0)
+    {
+      *axes[i] = info.value;
+    }
+    else
+    {
+      success = false;
+    }
+  }
+
+  unsigned char key_mask[(KEY_MAX + 7) / 8];
+  memset(key_mask, 0, sizeof key_mask);
+  if (rt_dev_ioctl(fd, EVIOCGKEY(sizeof key_mask), key_mask) >= 0)
+  {
+    for (int i = 0; i < getNumButtons(); i++)
+    {
+      const int code = buttonIndexToCode(i);
+      snapshot.buttons.set(i, availableButtons.test(i) && ((key_mask[code / 8] >> (code % 8)) & 1));
+    }
+  }
+  else
+  {
+    success = false;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  snapshot.timestamp = (long long)now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+
+  pendingValues = snapshot;
+  commitFrame();
+  return success;
+}
+
+void SpaceNavHID::commitFrame()
+{
+  // a press edge toggles the respective button state.
+  toggles = toggles.changed(pendingValues.buttons.pressed(oldValues.buttons));
+
+  // queue every edge with the time stamp of its frame.
+  uint64_t edges = pendingValues.buttons.changed(oldValues.buttons).bits;
+  while (edges)
+  {
+    SpaceNavButtonEvent event;
+    event.timestamp = pendingValues.timestamp;
+    event.button = __builtin_ctzll(edges);
+    event.pressed = pendingValues.buttons.test(event.button);
+    if (!buttonEvents.push(event))
+    {
+      buttonEventOverflows++;
+    }
+    edges &= edges - 1;
+  }
+  pendingValues.button1 = pendingValues.buttons.test(0);
+  pendingValues.button2 = pendingValues.buttons.test(1);
+  if (subscribedMask)
+  {
+    dispatch(oldValues, pendingValues);
+  }
+  if (history)
+  {
+    const int axes[6] = {(int)pendingValues.tx, (int)pendingValues.ty, (int)pendingValues.tz,
+                         (int)pendingValues.rx, (int)pendingValues.ry, (int)pendingValues.rz};
+    history->push(pendingValues.timestamp, axes, pendingValues.buttons.bits);
+  }
+  oldValues = pendingValues;
+  frameCount++;
+}
+
+void SpaceNavHID::dispatch(const SpaceNavValues &previous, const SpaceNavValues &frame)
+{
+  SpaceNavValues scaled;
+  scaleValues(frame, scaled);
+
+  SpaceNavEvent event;
+  event.raw = &frame;
+  event.scaled = &scaled;
+  event.axis = -1;
+  event.value = 0;
+  event.button.timestamp = frame.timestamp;
+  event.button.button = -1;
+  event.button.pressed = false;
+
+  if (subscribedMask & SPACENAV_EVENT_FRAME)
+  {
+    event.type = SPACENAV_EVENT_FRAME;
+    for (int s = 0; s < MAX_SUBSCRIBERS; s++)
+    {
+      if (subscribers[s].mask & SPACENAV_EVENT_FRAME)
+      {
+        subscribers[s].callback(subscribers[s].context, event);
+      }
+    }
+  }
+
+  if (subscribedMask & SPACENAV_EVENT_AXIS)
+  {
+    event.type = SPACENAV_EVENT_AXIS;
+    const double before[6] = {previous.tx, previous.ty, previous.tz, previous.rx, previous.ry, previous.rz};
+    const double after[6] = {frame.tx, frame.ty, frame.tz, frame.rx, frame.ry, frame.rz};
+    const double values[6] = {scaled.tx, scaled.ty, scaled.tz, scaled.rx, scaled.ry, scaled.rz};
+    for (int i = 0; i < 6; i++)
+    {
+      const int axis = device->axisMap[i];
+      if (before[axis] == after[axis])
+      {
+        continue;
+      }
+      event.axis = i;
+      event.value = values[i];
+      for (int s = 0; s < MAX_SUBSCRIBERS; s++)
+      {
+        if (subscribers[s].mask & SPACENAV_EVENT_AXIS)
+        {
+          subscribers[s].callback(subscribers[s].context, event);
+        }
+      }
+    }
+    event.axis = -1;
+    event.value = 0;
+  }
+
+  if (subscribedMask & SPACENAV_EVENT_BUTTON)
+  {
+    event.type = SPACENAV_EVENT_BUTTON;
+    uint64_t edges = frame.buttons.changed(previous.buttons).bits;
+    while (edges)
+    {
+      event.button.button = __builtin_ctzll(edges);
+      event.button.pressed = frame.buttons.test(event.button.button);
+      for (int s = 0; s < MAX_SUBSCRIBERS; s++)
+      {
+        if (subscribers[s].mask & SPACENAV_EVENT_BUTTON)
+        {
+          subscribers[s].callback(subscribers[s].context, event);
+        }
+      }
+      edges &= edges - 1;
+    }
+  }
+}
+
+int SpaceNavHID::subscribe(const unsigned int mask, SpaceNavCallback callback, void *context)
+{
+  if (!callback || !(mask & SPACENAV_EVENT_ALL))
+  {
+    return -1;
+  }
+  for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+  {
+    if (!subscribers[i].callback)
+    {
+      subscribers[i].mask = mask & SPACENAV_EVENT_ALL;
+      subscribers[i].callback = callback;
+      subscribers[i].context = context;
+      subscribedMask |= subscribers[i].mask;
+      return i;
+    }
+  }
+  return -1;
+}
+
+void SpaceNavHID::unsubscribe(const int id)
+{
+  if (id < 0 || id >= MAX_SUBSCRIBERS)
+  {
+    return;
+  }
+  subscribers[id].mask = 0;
+  subscribers[id].callback = NULL;
+  subscribers[id].context = NULL;
+  subscribedMask = 0;
+  for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+  {
+    subscribedMask |= subscribers[i].mask;
+  }
+}
+
+int SpaceNavHID::enableHistory(const long long windowUs)
+{
+  if (!history)
+  {
+    history = new SpaceNavHistory(windowUs);
+    return 0;
+  }
+  const int window = history->addWindow(windowUs);
+  if (window < 0)
+  {
+    std::cerr << "[SpaceNavHID] "
+              << "No window of " << windowUs << " us left, the history has " << SpaceNavHistory::MAX_WINDOWS << " windows already." << std::endl;
+  }
+  return window;
+}
+
+const SpaceNavHistory *SpaceNavHID::getHistory()
+{
+  return history;
+}
+
+SpaceNavMetrics &SpaceNavHID::getMetrics()
+{
+  return metrics;
+}
+
+void SpaceNavHID::setCalibration(const SpaceNavCalibration &c)
+{
+  std::lock_guard<std::mutex> lock(calibrationMutex);
+  pendingCalibration = c;
+  pendingCalibrationValid = true;
+  calibrationVersion.fetch_add(1, std::memory_order_release);
+}
+
+void SpaceNavHID::clearCalibration()
+{
+  std::lock_guard<std::mutex> lock(calibrationMutex);
+  pendingCalibrationValid = false;
+  calibrationVersion.fetch_add(1, std::memory_order_release);
+}
+
+bool SpaceNavHID::getCalibration(SpaceNavCalibration &c)
+{
+  std::lock_guard<std::mutex> lock(calibrationMutex);
+  c = pendingCalibration;
+  return pendingCalibrationValid;
+}
+
+bool SpaceNavHID::isCalibrated()
+{
+  return calibrated;
+}
+
+unsigned long SpaceNavHID::getDroppedCount()
+{
+  return droppedCount;
+}
+
+SpaceNavRtReport SpaceNavHID::hardenCurrentThread(const SpaceNavRtOptions &options)
+{
+  SpaceNavRtReport report;
+  report.scheduler = true;
+  report.affinity = true;
+  report.memoryLocked = true;
+  report.stackPrefaulted = true;
+  report.buffersPrefaulted = true;
+
+  if (options.priority > 0)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof param);
+    param.sched_priority = options.priority;
+    report.scheduler = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+  }
+
+  if (options.cpu >= 0)
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(options.cpu, &cpus);
+    report.affinity = pthread_setaffinity_np(pthread_self(), sizeof cpus, &cpus) == 0;
+  }
+
+  if (options.lockMemory)
+  {
+    report.memoryLocked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+  }
+
+  if (options.prefaultStack > 0)
+  {
+    // do not run into the guard page of a small thread stack.
+    pthread_attr_t attr;
+    void *stackAddr;
+    size_t stackSize = 0;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0)
+    {
+      pthread_attr_getstack(&attr, &stackAddr, &stackSize);
+      pthread_attr_destroy(&attr);
+    }
+    if (stackSize == 0 || options.prefaultStack > stackSize / 2)
+    {
+      report.stackPrefaulted = false;
+    }
+    else
+    {
+      // grow the stack now, with locked memory the pages stay.
+      volatile unsigned char *stack = (volatile unsigned char *)alloca(options.prefaultStack);
+      const long page = sysconf(_SC_PAGESIZE);
+      for (unsigned long i = 0; i < options.prefaultStack; i += page)
+      {
+        stack[i] = 0;
+      }
+    }
+  }
+
+#ifdef SPACENAV_TRACING
+  // the trace ring is written by the trace points of this thread, create and clear it now
+  // so its page faults are not counted against the steady state.
+  spacenavTraceAttachThread();
+#endif
+
+  // fault in everything getValue() touches: the state, the edge queue, the range table and
+  // the history. Only read, other threads (e.g. the calibrator) use parts of this object.
+  // The memory was written on construction, so the pages are private and writable already.
+  prefault(this, sizeof(*this));
+  if (absinfo)
+  {
+    prefault(absinfo, (num_axes < 6 ? 6 : num_axes) * sizeof(input_absinfo_td));
+  }
+  else
+  {
+    report.buffersPrefaulted = false;
+  }
+  if (history)
+  {
+    prefault(history, sizeof(*history));
+  }
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) == 0)
+  {
+    majorFaultsAtHardening = usage.ru_majflt;
+    minorFaultsAtHardening = usage.ru_minflt;
+  }
+
+  return report;
+}
+
+void SpaceNavHID::prefault(const void *memory, const size_t size)
+{
+  const volatile unsigned char *bytes = (const volatile unsigned char *)memory;
+  const long page = sysconf(_SC_PAGESIZE);
+  unsigned char sink = 0;
+  for (size_t i = 0; i < size; i += page)
+  {
+    sink ^= bytes[i];
+  }
+  // the last page if the size is not a multiple of the page size.
+  if (size > 0)
+  {
+    sink ^= bytes[size - 1];
+  }
+  (void)sink;
+}
+
+long SpaceNavHID::getMajorFaultsSinceHardening()
+{
+  struct rusage usage;
+  if (majorFaultsAtHardening < 0 || getrusage(RUSAGE_THREAD, &usage) != 0)
+  {
+    return -1;
+  }
+  return usage.ru_majflt - majorFaultsAtHardening;
+}
+
+long SpaceNavHID::getMinorFaultsSinceHardening()
+{
+  struct rusage usage;
+  if (minorFaultsAtHardening < 0 || getrusage(RUSAGE_THREAD, &usage) != 0)
+  {
+    return -1;
+  }
+  return usage.ru_minflt - minorFaultsAtHardening;
+}
+
+unsigned long SpaceNavHID::getFrameCount()
+{
+  return frameCount;
+}
+
+bool SpaceNavHID::popButtonEvent(SpaceNavButtonEvent &event)
+{
+  return buttonEvents.pop(event);
+}
+
+unsigned long SpaceNavHID::getButtonEventOverflowCount()
+{
+  return buttonEventOverflows;
+}
+
 bool SpaceNavHID::checkDeviceId(const int fd, input_id_td &device_info)
 {
   /*
@@ -318,31 +889,13 @@ bool SpaceNavHID::checkDeviceId(const int fd, input_id_td &device_info)
 
   // Code from https://github.com/janoc/libndofdev/blob/master/ndofdev.c#L101-L127
 
+  rt_dev_ioctl(fd, EVIOCGID, &device_info); // get device ID
   std::cout << "check vendor " << device_info.vendor << " and product " << device_info.product << std::endl;
 
-  rt_dev_ioctl(fd, EVIOCGID, &device_info);   // get device ID
-  if (                                        //http://spacemice.org/index.php?title=Dev
-      ((device_info.vendor == 0x046d) &&      // Logitech's Vendor ID, used by 3DConnexion until they got their own.
-       (                                      //(ID.product == 0xc603) || // SpaceMouse (untested)
-                                              //(ID.product == 0xc605) || // CADMan (untested)
-                                              //(ID.product == 0xc606) || // SpaceMouse Classic (untested)
-                                              //(ID.product == 0xc621) || // SpaceBall 5000
-                                              //(ID.product == 0xc623) || // SpaceTraveler (untested)
-                                              //(ID.product == 0xc625) || // SpacePilot (untested)
-           (device_info.product == 0xc626) || // SpaceNavigators
-                                              //(ID.product == 0xc627) || // SpaceExplorer (untested)
-                                              //(ID.product == 0xc628) || // SpaceNavigator for Notebooks (untested)
-                                              //(ID.product == 0xc629) || // SpacePilot Pro (untested)
-                                              //(ID.product == 0xc62b) || // SpaceMousePro
-           0)) ||
-      ((device_info.vendor == 0x256F) && // 3Dconnexion's Vendor ID
-       (
-           (device_info.product == 0xc62E) || // SpaceMouse Wireless (cable) (untested)
-           (device_info.product == 0xc62F) || // SpaceMouse Wireless (receiver) (untested)
-           (device_info.product == 0xc631) || // Spacemouse Wireless (untested)
-           (device_info.product == 0xc632) || // SpacemousePro Wireless (untested)
-           0)))
+  const SpaceNavDeviceInfo *info = findDeviceInfo(device_info.vendor, device_info.product);
+  if (info)
   {
+    device = info;
     return true;
   }
   return false;
@@ -350,19 +903,19 @@ bool SpaceNavHID::checkDeviceId(const int fd, input_id_td &device_info)
 
 void SpaceNavHID::closeDevice()
 {
-  if (fd > 0)
+  if (fd > -1)
   {
     rt_dev_close(fd);
   }
   fd = -1;
 }
 
-int SpaceNavHID::determineDeviceMode(const char *device_path)
+int SpaceNavHID::determineDeviceMode(const char *device_path, int &device_fd)
 {
-  int device_fd = -1;
-  if ((device_fd = rt_dev_open(device_path, O_RDWR)) == -1)
+  device_fd = -1;
+  if ((device_fd = rt_dev_open(device_path, O_RDWR | O_NONBLOCK)) == -1)
   {
-    if ((device_fd = rt_dev_open(device_path, O_RDONLY)) == -1)
+    if ((device_fd = rt_dev_open(device_path, O_RDONLY | O_NONBLOCK)) == -1)
     {
       perror("opening the file you specified");
       return -1;
@@ -383,46 +936,77 @@ int SpaceNavHID::determineDeviceMode(const char *device_path)
 
 void SpaceNavHID::getValue(SpaceNavValues &coordinates, SpaceNavValues &rawValues)
 {
-  rawValues = oldValues;
-  /* If input events don't come in fast enough a certain DoF may not be 
-   * updated during a frame. This results in choppy and ugly animation.
-   * To solve this we record the number of frames a certain DoF was idle
-   * and only set the DoF to 0 if we reach a certain idleThreshold.
-   * When there is activity on an axis the idleFrameCount is reset to 0.
-   */
-  int i, eventCnt;
   /* how many bytes were read */
-  size_t bytesRead;
+  ssize_t bytesRead;
   /* the events (up to 64 at once) */
   struct input_event events[64];
-  /* keep track of idle frames for each DoF for smoother animation. see above */
-  static int idleFrameCount[6] = {0, 0, 0, 0, 0, 0};
-  // int idleThreshold = 3;
 
   /* read the raw event data from the device */
   bytesRead = rt_dev_read(fd, events, sizeof(struct input_event) * 64);
-  eventCnt = (int)((long)bytesRead / (long)sizeof(struct input_event));
-  if (bytesRead < (int)sizeof(struct input_event))
+  SPACENAV_TRACE(READ, bytesRead, bytesRead / (ssize_t)sizeof(struct input_event), dropping, bytesRead < 0 ? errno : 0);
+  if (bytesRead < (ssize_t)sizeof(struct input_event))
   {
-    perror("evtest: short read");
+    metrics.add(bytesRead > 0 ? SPACENAV_METRIC_SHORT_READS : SPACENAV_METRIC_EMPTY_READS);
+    if (bytesRead < 0 && errno != EAGAIN)
+    {
+      perror("evtest: short read");
+    }
+    // nothing new, but the caller still gets the latest committed frame.
+    rawValues = oldValues;
+    scaleValues(rawValues, coordinates);
     return;
   }
+  processEvents(events, bytesRead, coordinates, rawValues);
+}
 
-  /* Increase all idle counts. They are later reset if there is activity */
-  for (i = 0; i < 6; i++)
-  {
-    idleFrameCount[i]++;
-  }
+void SpaceNavHID::processEvents(const void *buffer, const long bytes, SpaceNavValues &coordinates, SpaceNavValues &rawValues)
+{
+  /* Events are only applied to pendingValues. The complete frame becomes visible
+   * (oldValues) on the terminating SYN_REPORT, so that a consumer never sees a
+   * half-updated set of axes. A SYN_DROPPED means that the kernel buffer overran:
+   * everything up to the next SYN_REPORT is discarded and the state is queried
+   * from the device instead.
+   */
+  const struct input_event *events = (const struct input_event *)buffer;
+  const int eventCnt = (int)(bytes / (long)sizeof(struct input_event));
+  int i;
+  // counted locally, the shared counters are touched once per call.
+  unsigned long long eventsByType[SPACENAV_METRIC_EVENTS_OTHER - SPACENAV_METRIC_EVENTS_SYN + 1] = {0, 0, 0, 0, 0};
 
   /* handle input events sequentially */
   for (i = 0; i < eventCnt; i++)
   {
-
-    if (events[i].type == EV_SYN || events[i].type == EV_MSC)
-      continue; // ignore EV_MSC and EV_SYN events
+    const int type = events[i].type;
+    eventsByType[type <= EV_ABS ? type : SPACENAV_METRIC_EVENTS_OTHER - SPACENAV_METRIC_EVENTS_SYN]++;
+    if (dropping)
+    {
+      // discard everything until the next report and ask the device for its state.
+      if (events[i].type == EV_SYN && events[i].code == SYN_REPORT)
+      {
+        dropping = false;
+        resynchronize();
+      }
+      continue;
+    }
 
     switch (events[i].type)
     {
+    case EV_SYN:
+    {
+      if (events[i].code == SYN_REPORT)
+      {
+        pendingValues.timestamp = (long long)events[i].input_event_sec * 1000000LL + events[i].input_event_usec;
+        commitFrame();
+      }
+      else if (events[i].code == SYN_DROPPED)
+      {
+        droppedCount++;
+        metrics.add(SPACENAV_METRIC_SYN_DROPPED);
+        dropping = true;
+        pendingValues = oldValues;
+      }
+      break;
+    }
     case EV_REL:
       // should not occur...
     case EV_ABS:
@@ -432,33 +1016,27 @@ void SpaceNavHID::getValue(SpaceNavValues &coordinates, SpaceNavValues &rawValue
       {
       // case ABS_X: //Same value as REL_* so because of the check above, this is not needed
       case 0:
-        rawValues.tx = events[i].value;
-        idleFrameCount[0] = 0;
+        pendingValues.tx = events[i].value;
         break;
       //case ABS_Y:
       case 1:
-        rawValues.ty = events[i].value;
-        idleFrameCount[1] = 0;
+        pendingValues.ty = events[i].value;
         break;
       //case ABS_Z:
       case 2:
-        rawValues.tz = events[i].value;
-        idleFrameCount[2] = 0;
+        pendingValues.tz = events[i].value;
         break;
       //case ABS_RX:
       case 3:
-        rawValues.rx = events[i].value;
-        idleFrameCount[3] = 0;
+        pendingValues.rx = events[i].value;
         break;
       //case ABS_RY:
       case 4:
-        rawValues.ry = events[i].value;
-        idleFrameCount[4] = 0;
+        pendingValues.ry = events[i].value;
         break;
       //case ABS_RZ:
       case 5:
-        rawValues.rz = events[i].value;
-        idleFrameCount[5] = 0;
+        pendingValues.rz = events[i].value;
         break;
 
       default:
@@ -468,63 +1046,65 @@ void SpaceNavHID::getValue(SpaceNavValues &coordinates, SpaceNavValues &rawValue
     }
     case EV_KEY:
     {
-      int btn_index = events[i].code - BTN_0;
+      const int btn_index = buttonCodeToIndex(events[i].code);
 
-      if (btn_index == 0)
+      if (btn_index >= 0 && availableButtons.test(btn_index))
       {
-        rawValues.button1 = events[i].value;
-        if (events[i].value == 1)
-        {
-          if (btn_0_pressed)
-          {
-            btn_0_pressed = false;
-            coordinates.button1 = 0;
-            // setLedState(0);
-          }
-          else
-          {
-            btn_0_pressed = true;
-            coordinates.button1 = 1;
-            // setLedState(1);
-          }
-        }
-      }
-      else if (btn_index == 1)
-      {
-        rawValues.button2 = events[i].value;
-        if (events[i].value == 1)
-        {
-          if (btn_1_pressed)
-          {
-            btn_1_pressed = false;
-            coordinates.button2 = 0;
-            //setLedState(0);
-          }
-          else
-          {
-            btn_1_pressed = true;
-            coordinates.button2 = 1;
-            //setLedState(1);
-          }
-        }
+        pendingValues.buttons.set(btn_index, events[i].value != 0);
       }
       break;
     }
     default:
+      // ignore EV_MSC and friends
       break;
     }
   }
 
-  // translation
-  coordinates.tx = -1 * getSlopedOutput(1, rawValues.tx);
-  coordinates.ty = -1 * getSlopedOutput(0, rawValues.ty);
-  coordinates.tz = -1 * getSlopedOutput(2, rawValues.tz);
-  // rotation
-  coordinates.rx = -1 * getSlopedOutput(3, rawValues.rx);
-  coordinates.ry = -1 * getSlopedOutput(4, rawValues.ry);
-  coordinates.rz = -1 * getSlopedOutput(5, rawValues.rz);
+  metrics.add(SPACENAV_METRIC_READS);
+  metrics.add(SPACENAV_METRIC_BYTES, bytes);
+  if (bytes % (long)sizeof(struct input_event))
+  {
+    metrics.add(SPACENAV_METRIC_SHORT_READS);
+  }
+  for (i = 0; i <= SPACENAV_METRIC_EVENTS_OTHER - SPACENAV_METRIC_EVENTS_SYN; i++)
+  {
+    if (eventsByType[i])
+    {
+      metrics.add(SpaceNavMetric(SPACENAV_METRIC_EVENTS_SYN + i), eventsByType[i]);
+    }
+  }
 
-  oldValues = rawValues;
+  SPACENAV_TRACE(DECODE, frameCount, droppedCount, oldValues.buttons.bits, buttonEventOverflows);
+  rawValues = oldValues;
+  scaleValues(rawValues, coordinates);
+  SPACENAV_TRACE(SCALE_T, coordinates.tx, coordinates.ty, coordinates.tz, 0);
+  SPACENAV_TRACE(SCALE_R, coordinates.rx, coordinates.ry, coordinates.rz, 0);
+}
+
+void SpaceNavHID::scaleValues(const SpaceNavValues &rawValues, SpaceNavValues &coordinates)
+{
+  // take over a new calibration without ever waiting for the thread which sets it.
+  if (calibrationVersion.load(std::memory_order_acquire) != calibrationSeen && calibrationMutex.try_lock())
+  {
+    calibration = pendingCalibration;
+    calibrated = pendingCalibrationValid;
+    calibrationSeen = calibrationVersion.load(std::memory_order_relaxed);
+    calibrationMutex.unlock();
+  }
+
+  // remap the device axes to translation and rotation
+  const double raw[6] = {rawValues.tx, rawValues.ty, rawValues.tz, rawValues.rx, rawValues.ry, rawValues.rz};
+  double *scaled[6] = {&coordinates.tx, &coordinates.ty, &coordinates.tz, &coordinates.rx, &coordinates.ry, &coordinates.rz};
+  for (int i = 0; i < 6; i++)
+  {
+    const int axis = device->axisMap[i];
+    *scaled[i] = device->axisSign[i] * (calibrated ? getCalibratedOutput(axis, raw[axis]) : getSlopedOutput(axis, raw[axis]));
+  }
+  // buttons are reported as toggle states
+  coordinates.buttons = toggles;
+  coordinates.button1 = toggles.test(0);
+  coordinates.button2 = toggles.test(1);
+  coordinates.timestamp = rawValues.timestamp;
 }
 
 double SpaceNavHID::getSlopedOutput(const int axisIndex, const double value)
@@ -535,9 +1115,24 @@ double SpaceNavHID::getSlopedOutput(const int axisIndex, const double value)
   return DEF_MINVAL + floor((slope * (value - input_start)) + 0.5);
 }
 
+double SpaceNavHID::getCalibratedOutput(const int axisIndex, const double value)
+{
+  const SpaceNavAxisCalibration &axis = calibration.axes[axisIndex];
+  const double offset = value - axis.bias;
+  const double magnitude = fabs(offset) - axis.deadzone;
+  if (magnitude <= 0)
+  {
+    return 0;
+  }
+  // the output starts at zero at the edge of the deadzone, without a step.
+  const double travel = (offset > 0 ? axis.maximum - axis.bias : axis.bias - axis.minimum) - axis.deadzone;
+  const double output = travel > 0 ? floor(magnitude / travel * DEF_MAXVAL + 0.5) : DEF_MAXVAL;
+  return offset > 0 ? output : -output;
+}
+
 bool SpaceNavHID::setLedState(const int state)
 {
-  if (fd == -1)
+  if (fd == -1 || !device || !device->hasLed)
   {
     return false;
   }
@@ -551,6 +1146,62 @@ bool SpaceNavHID::setLedState(const int state)
   {
     return false;
   }
+  metrics.add(SPACENAV_METRIC_LED_WRITES);
+  return true;
+}
+
+bool SpaceNavHID::setExclusive(const bool exclusive)
+{
+  if (fd == -1)
+  {
+    return false;
+  }
+  return rt_dev_ioctl(fd, EVIOCGRAB, exclusive ? 1 : 0) == 0;
+}
+
+void SpaceNavHID::setVirtualDevicesAllowed(const bool allowed)
+{
+  virtualDevicesAllowed = allowed;
+}
+
+bool SpaceNavHID::isVirtual(const int fd)
+{
+  char name[256];
+  memset(name, 0, sizeof name);
+  return rt_dev_ioctl(fd, EVIOCGNAME(sizeof name - 1), name) >= 0 && strstr(name, "(virtual)");
+}
+
+bool SpaceNavHID::isAvailable(const int fd)
+{
+  if (isVirtual(fd))
+  {
+    return false;
+  }
+  // a device grabbed by another re-emitter delivers no events. The probe takes the device from
+  // every other reader for a moment, which is fine for a re-emitter that grabs it right after.
+  const int result = rt_dev_ioctl(fd, EVIOCGRAB, 1);
+#ifdef XENOMAI_VERSION_MAJOR
+  // rtdm returns -errno and leaves errno alone.
+  const int error = result < 0 ? -result : 0;
+#else
+  const int error = result < 0 ? errno : 0;
+#endif
+  if (error != 0)
+  {
+    return error != EBUSY;
+  }
+  rt_dev_ioctl(fd, EVIOCGRAB, 0);
+  return true;
+}
+
+bool SpaceNavHID::getAxisRange(const int axisIndex, int &minimum, int &maximum)
+{
+  if (!absinfo || axisIndex < 0 || axisIndex >= (num_axes < 6 ? 6 : num_axes))
+  {
+    return false;
+  }
+  minimum = absinfo[axisIndex].minimum;
+  maximum = absinfo[axisIndex].maximum;
   return true;
 }
 
@@ -559,6 +1210,20 @@ int SpaceNavHID::getNumAxes()
   return num_axes;
 }
 
+int SpaceNavHID::getNumButtons()
+{
+  if (!device)
+  {
+    return 0;
+  }
+  return device->numButtons < SpaceNavButtons::MAX_BUTTONS ? device->numButtons : SpaceNavButtons::MAX_BUTTONS;
+}
+
+const SpaceNavDeviceInfo *SpaceNavHID::getDeviceInfo()
+{
+  return device;
+}
+
 } // namespace hw
 
 } // namespace cosima
\ No newline at end of file
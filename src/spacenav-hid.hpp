@@ -46,6 +46,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _COSIMA_SpaceNavHID_H_
 #define _COSIMA_SpaceNavHID_H_
 
+#include <stdint.h>
+#include "spacenav-devices.hpp"
+#include "spacenav-spsc.hpp"
+#include "spacenav-history.hpp"
+#include "spacenav-metrics.hpp"
+#include "spacenav-calibration.hpp"
+
 typedef struct input_id input_id_td;
 typedef struct input_absinfo input_absinfo_td;
 
@@ -55,6 +62,124 @@ namespace cosima
 namespace hw
 {
 
+/**
+ * Fixed-size button state, one bit per button index (see buttonIndexToCode()).
+ */
+class SpaceNavButtons
+{
+public:
+  static const int MAX_BUTTONS = 64;
+
+  uint64_t bits;
+
+  SpaceNavButtons() : bits(0) {}
+
+  explicit SpaceNavButtons(const uint64_t b) : bits(b) {}
+
+  bool test(const int index) const
+  {
+    return (bits >> index) & 1;
+  }
+
+  void set(const int index, const bool value)
+  {
+    const uint64_t mask = uint64_t(1) << index;
+    bits = (bits & ~mask) | (-uint64_t(value) & mask);
+  }
+
+  /**
+   * Buttons whose state differs from other.
+   */
+  SpaceNavButtons changed(const SpaceNavButtons &other) const
+  {
+    return SpaceNavButtons(bits ^ other.bits);
+  }
+
+  /**
+   * Buttons which are set here, but were not set in previous.
+   */
+  SpaceNavButtons pressed(const SpaceNavButtons &previous) const
+  {
+    return SpaceNavButtons(bits & ~previous.bits);
+  }
+
+  /**
+   * Buttons which were set in previous, but are not set here.
+   */
+  SpaceNavButtons released(const SpaceNavButtons &previous) const
+  {
+    return SpaceNavButtons(~bits & previous.bits);
+  }
+
+  bool any() const
+  {
+    return bits != 0;
+  }
+
+  void reset()
+  {
+    bits = 0;
+  }
+};
+
+/**
+ * A single press or release edge of a button.
+ */
+struct SpaceNavButtonEvent
+{
+  /**
+   * Kernel time stamp of the frame containing the edge, in microseconds.
+   */
+  long long timestamp;
+  /**
+   * Button index (see buttonIndexToCode()).
+   */
+  int button;
+  bool pressed;
+};
+
+/**
+ * Opt-in hardening of the thread which reads the device.
+ */
+struct SpaceNavRtOptions
+{
+  /**
+   * SCHED_FIFO priority, 0 keeps the current scheduler.
+   */
+  int priority;
+  /**
+   * CPU to pin the thread to, -1 keeps the current affinity.
+   */
+  int cpu;
+  /**
+   * mlockall(MCL_CURRENT | MCL_FUTURE).
+   */
+  bool lockMemory;
+  /**
+   * Bytes of stack to touch up front, 0 skips it.
+   */
+  unsigned long prefaultStack;
+
+  SpaceNavRtOptions() : priority(80), cpu(-1), lockMemory(true), prefaultStack(256 * 1024) {}
+};
+
+/**
+ * Outcome of each hardening step. Steps which were not requested count as succeeded.
+ */
+struct SpaceNavRtReport
+{
+  bool scheduler;
+  bool affinity;
+  bool memoryLocked;
+  bool stackPrefaulted;
+  bool buffersPrefaulted;
+
+  bool success() const
+  {
+    return scheduler && affinity && memoryLocked && stackPrefaulted && buffersPrefaulted;
+  }
+};
+
 class SpaceNavValues
 {
 public:
@@ -66,6 +191,15 @@ public:
   double rz;
   int button1;
   int button2;
+  /**
+   * State of all buttons: pressed state for raw values, toggle state for coordinates.
+   * button1 and button2 mirror the first two bits.
+   */
+  SpaceNavButtons buttons;
+  /**
+   * Kernel time stamp of the SYN_REPORT which committed this frame, in microseconds.
+   */
+  long long timestamp;
 
   SpaceNavValues()
   {
@@ -80,12 +214,53 @@ public:
     ty = 0;
     tz = 0;
     rx = 0;
+    ry = 0;
     rz = 0;
     button1 = false;
     button2 = false;
+    buttons.reset();
+    timestamp = 0;
   }
 };
 
+/**
+ * Kinds of events a subscriber can ask for, combined as mask.
+ */
+enum SpaceNavEventType
+{
+  SPACENAV_EVENT_FRAME = 1,  // every committed frame
+  SPACENAV_EVENT_AXIS = 2,   // every axis which changed in a committed frame
+  SPACENAV_EVENT_BUTTON = 4, // every button edge
+  SPACENAV_EVENT_ALL = 7
+};
+
+/**
+ * Event handed to subscribers. Pointers are only valid during the callback.
+ */
+struct SpaceNavEvent
+{
+  SpaceNavEventType type;
+  /**
+   * FRAME and AXIS: the committed raw frame and its scaled counterpart.
+   */
+  const SpaceNavValues *raw;
+  const SpaceNavValues *scaled;
+  /**
+   * AXIS: logical axis (0 = tx ... 5 = rz) and its new scaled value.
+   */
+  int axis;
+  double value;
+  /**
+   * BUTTON: the edge.
+   */
+  SpaceNavButtonEvent button;
+};
+
+/**
+ * Plain function pointer, context is passed through unchanged.
+ */
+typedef void (*SpaceNavCallback)(void *context, const SpaceNavEvent &event);
+
 class SpaceNavHID
 {
 
@@ -99,31 +274,300 @@ public:
 
   int getFileDescriptor();
 
+  /**
+   * Uses an already opened descriptor instead of searching for a device, e.g. a device
+   * opened elsewhere or a pipe with recorded events. The descriptor is closed by closeDevice().
+   * Axis ranges which cannot be queried keep their defaults.
+   */
+  bool attachDescriptor(const int descriptor, const SpaceNavDeviceInfo *info);
+
+  /**
+   * Reads the pending events from the device (one read) and decodes them.
+   * Both outputs hold the latest committed frame afterwards, also if nothing was pending.
+   */
   void getValue(SpaceNavValues &coordiantes, SpaceNavValues &rawValues);
 
+  /**
+   * Decodes events which were read by someone else, e.g. a batched reader.
+   * bytes is the size of the buffer of struct input_event.
+   */
+  void processEvents(const void *buffer, const long bytes, SpaceNavValues &coordinates, SpaceNavValues &rawValues);
+
   bool setLedState(const int state);
 
+  /**
+   * Grabs the device exclusively (EVIOCGRAB): no other reader gets its events until it is released
+   * or closed. Returns false if the device is already grabbed by someone else.
+   */
+  bool setExclusive(const bool exclusive);
+
+  /**
+   * Whether initDevice() may open virtual devices (named "... (virtual)", e.g. the output of
+   * spacenav-hid-reemit). On by default, a virtual device is then preferred over the physical
+   * one, which the re-emitter grabs. Off (re-emit mode), virtual devices and devices grabbed by
+   * another process are skipped; only then the device is probed with a short grab.
+   */
+  void setVirtualDevicesAllowed(const bool allowed);
+
+  /**
+   * Raw range of a device axis (0 = ABS_X ... 5 = ABS_RZ) as queried from the device.
+   */
+  bool getAxisRange(const int axisIndex, int &minimum, int &maximum);
+
   int getNumAxes();
 
+  int getNumButtons();
+
+  /**
+   * Capabilities of the opened device, NULL if no device was found.
+   */
+  const SpaceNavDeviceInfo *getDeviceInfo();
+
+  /**
+   * Re-reads the current axis and button state from the device (EVIOCGABS / EVIOCGKEY)
+   * and commits it as the current frame.
+   */
+  bool resynchronize();
+
+  /**
+   * Number of SYN_DROPPED events, i.e. kernel buffer overruns, seen since initDevice().
+   */
+  unsigned long getDroppedCount();
+
+  /**
+   * Number of frames committed since initDevice(). Several frames may be committed by one getValue().
+   */
+  unsigned long getFrameCount();
+
+  /**
+   * Takes the oldest button edge from the queue which is filled by getValue().
+   * Needs to be called from a single consumer thread. Returns false if no edge is pending.
+   */
+  bool popButtonEvent(SpaceNavButtonEvent &event);
+
+  /**
+   * Number of button edges which were lost because the queue was full.
+   */
+  unsigned long getButtonEventOverflowCount();
+
+  static const int MAX_SUBSCRIBERS = 8;
+
+  /**
+   * Registers a callback for the event types in mask. Callbacks run in the thread which
+   * calls getValue() / processEvents(), right when a frame is committed.
+   * Subscribe and unsubscribe while nobody reads. Returns the id, -1 if all slots are taken.
+   */
+  int subscribe(const unsigned int mask, SpaceNavCallback callback, void *context);
+
+  /**
+   * Same for a member function, e.g. subscribe<Robot, &Robot::onFrame>(SPACENAV_EVENT_FRAME, &robot).
+   * No std::function and no virtual call, the trampoline is a plain function.
+   */
+  template <class T, void (T::*Method)(const SpaceNavEvent &)>
+  int subscribe(const unsigned int mask, T *object)
+  {
+    return subscribe(mask, &memberTrampoline<T, Method>, object);
+  }
+
+  void unsubscribe(const int id);
+
+  /**
+   * Starts recording every committed raw frame into a history with a running window of windowUs.
+   * The first call allocates, so make it before reading starts. Later calls keep the history
+   * and add a window of their own length (any time). Returns the index of the window for
+   * SpaceNavHistory::getWindow(), -1 if no window is left.
+   */
+  int enableHistory(const long long windowUs);
+
+  /**
+   * History of the committed raw frames, NULL unless enableHistory() was called.
+   * Readers may use it from any thread.
+   */
+  const SpaceNavHistory *getHistory();
+
+  /**
+   * Counters of the reading path. They are never reset, not even by initDevice(), and may be
+   * read from any thread. Users of the interface can add their own counts (e.g. port writes).
+   */
+  SpaceNavMetrics &getMetrics();
+
+  /**
+   * Replaces bias, deadzone and range of the raw axes used by the scaling, e.g. by a
+   * SpaceNavCalibrator. May be called from any thread; the reading thread takes it over
+   * with the next frame (or a later one if the calibration is being replaced right then).
+   */
+  void setCalibration(const SpaceNavCalibration &calibration);
+
+  /**
+   * Returns to the plain scaling of the device ranges.
+   */
+  void clearCalibration();
+
+  /**
+   * Last calibration passed to setCalibration(), false if there is none.
+   */
+  bool getCalibration(SpaceNavCalibration &calibration);
+
+  /**
+   * True if the scaling uses a calibration. Reading thread only.
+   */
+  bool isCalibrated();
+
+  /**
+   * Applies the options to the calling thread, which should be the one calling getValue(),
+   * reads every page of the buffers used while reading (never writes them, other threads may
+   * use them), maps the trace ring of the thread with SPACENAV_TRACING and starts counting
+   * page faults. The outcome is returned, not printed.
+   */
+  SpaceNavRtReport hardenCurrentThread(const SpaceNavRtOptions &options);
+
+  /**
+   * Major page faults of the hardened thread since hardenCurrentThread(), -1 if it was not hardened.
+   * Needs to be called from the hardened thread. In steady state this should stay at 0.
+   */
+  long getMajorFaultsSinceHardening();
+
+  /**
+   * Minor page faults of the hardened thread since hardenCurrentThread(), -1 if it was not hardened.
+   */
+  long getMinorFaultsSinceHardening();
+
 protected:
   int fd;
   int mode;
   int num_axes;
+  /**
+   * Last committed (complete) frame of raw values.
+   */
   SpaceNavValues oldValues;
-  bool btn_0_pressed;
-  bool btn_1_pressed;
+  /**
+   * Frame which is currently assembled from the incoming events until the next SYN_REPORT.
+   */
+  SpaceNavValues pendingValues;
+  /**
+   * Toggle state of the buttons, flipped on every press.
+   */
+  SpaceNavButtons toggles;
+  const SpaceNavDeviceInfo *device;
+  /**
+   * Buttons of the device which the kernel advertises (EVIOCGBIT(EV_KEY)), by index.
+   */
+  SpaceNavButtons availableButtons;
+  /**
+   * Every press and release edge, in the order they were committed.
+   */
+  SpaceNavSpscQueue<SpaceNavButtonEvent, 256> buttonEvents;
+  unsigned long buttonEventOverflows;
+  struct Subscriber
+  {
+    unsigned int mask;
+    SpaceNavCallback callback;
+    void *context;
+  };
+  Subscriber subscribers[MAX_SUBSCRIBERS];
+  /**
+   * Union of all subscriber masks, to skip the dispatch when nobody listens.
+   */
+  unsigned int subscribedMask;
+  SpaceNavHistory *history;
+  SpaceNavMetrics metrics;
+  /**
+   * A device was opened before, the next open counts as reconnect.
+   */
+  bool opened;
+  bool virtualDevicesAllowed;
+  /**
+   * Calibration handed over by setCalibration(), guarded by calibrationMutex and
+   * versioned so that the reading thread only locks (try_lock) when it changed.
+   */
+  std::mutex calibrationMutex;
+  SpaceNavCalibration pendingCalibration;
+  bool pendingCalibrationValid;
+  std::atomic<unsigned long> calibrationVersion;
+  /**
+   * Reading thread only: the calibration in use.
+   */
+  SpaceNavCalibration calibration;
+  bool calibrated;
+  unsigned long calibrationSeen;
+  long majorFaultsAtHardening;
+  long minorFaultsAtHardening;
+  /**
+   * True after a SYN_DROPPED until the next SYN_REPORT. All events in between are discarded.
+   */
+  bool dropping;
+  unsigned long droppedCount;
+  unsigned long frameCount;
 
 private:
+  /**
+   * Checks the device id against the table of supported devices and remembers its capabilities.
+   */
   bool checkDeviceId(const int fd, input_id_td &device_info);
 
   /**
      * Determines whether the device can use the LEDs (write mode == 1) or not (read mode only == 0).
      * If an error occurs the return value will be -1.
+     * On success device_fd holds the opened (non-blocking) device.
      */
-  int determineDeviceMode(const char *device_path);
+  int determineDeviceMode(const char *device_path, int &device_fd);
+
+  /**
+   * Closes the device and clears the decoder state before (re-)opening.
+   */
+  void resetState();
+
+  /**
+   * Reads one byte of every page, so that the pages are resident. Never writes,
+   * the memory may be shared with other threads.
+   */
+  static void prefault(const void *memory, const size_t size);
+
+  /**
+   * True if the opened device is a virtual one, named "... (virtual)".
+   */
+  bool isVirtual(const int fd);
+
+  /**
+   * False if the opened device is virtual or grabbed by another process. Grabs the device for
+   * a moment, only used while virtualDevicesAllowed is off.
+   */
+  bool isAvailable(const int fd);
+
+  /**
+   * Fills availableButtons from the key bits of the opened device. Falls back to all
+   * buttons of the device table if the descriptor reports none of them.
+   */
+  void queryButtons();
+
+  /**
+   * Commits pendingValues as the new current frame and updates the button toggle states.
+   */
+  void commitFrame();
+
+  /**
+   * Remaps and scales the raw axes, buttons become toggle states.
+   */
+  void scaleValues(const SpaceNavValues &rawValues, SpaceNavValues &coordinates);
+
+  /**
+   * Hands the frame which is about to be committed to the subscribers.
+   */
+  void dispatch(const SpaceNavValues &previous, const SpaceNavValues &frame);
+
+  template <class T, void (T::*Method)(const SpaceNavEvent &)>
+  static void memberTrampoline(void *object, const SpaceNavEvent &event)
+  {
+    (static_cast<T *>(object)->*Method)(event);
+  }
 
   double getSlopedOutput(const int axisIndex, const double value);
 
+  /**
+   * Removes bias and deadzone and maps the remaining travel to the output range.
+   */
+  double getCalibratedOutput(const int axisIndex, const double value);
+
   input_absinfo_td *absinfo;
 };
 
@@ -0,0 +1,416 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "spacenav-history.hpp"
+
+namespace cosima
+{
+
+namespace hw
+{
+
+SpaceNavHistory::SpaceNavHistory(const long long windowUs) : count(0),
+                                                             numWindows(1),
+                                                             activeWindows(0)
+{
+  for (unsigned int i = 0; i < CAPACITY; i++)
+  {
+    slots[i].version.store(0, std::memory_order_relaxed);
+    slots[i].timestamp.store(0, std::memory_order_relaxed);
+    for (int a = 0; a < 6; a++)
+    {
+      slots[i].axes[a].store(0, std::memory_order_relaxed);
+      values[i][a] = 0;
+    }
+    slots[i].buttons.store(0, std::memory_order_relaxed);
+    stamps[i] = 0;
+  }
+  for (int a = 0; a < 6; a++)
+  {
+    minQueue[a].tail = 0;
+    maxQueue[a].tail = 0;
+    // written here, so that the pages are present before the reading thread is hardened.
+    for (unsigned int i = 0; i < CAPACITY; i++)
+    {
+      minQueue[a].entries[i] = 0;
+      maxQueue[a].entries[i] = 0;
+    }
+  }
+  for (int w = 0; w < MAX_WINDOWS; w++)
+  {
+    Window &window = windows[w];
+    window.length.store(w == 0 ? windowUs : 0, std::memory_order_relaxed);
+    window.start = 0;
+    window.version.store(0, std::memory_order_relaxed);
+    window.count.store(0, std::memory_order_relaxed);
+    window.from.store(0, std::memory_order_relaxed);
+    window.to.store(0, std::memory_order_relaxed);
+    for (int a = 0; a < 6; a++)
+    {
+      window.sum[a] = 0;
+      window.sumSquares[a] = 0;
+      window.minHead[a] = 0;
+      window.maxHead[a] = 0;
+      window.mean[a].store(0, std::memory_order_relaxed);
+      window.variance[a].store(0, std::memory_order_relaxed);
+      window.min[a].store(0, std::memory_order_relaxed);
+      window.max[a].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+int SpaceNavHistory::addWindow(const long long windowUs)
+{
+  std::lock_guard<std::mutex> lock(windowsMutex);
+  const int n = numWindows.load(std::memory_order_relaxed);
+  for (int w = 0; w < n; w++)
+  {
+    if (windows[w].length.load(std::memory_order_relaxed) == windowUs)
+    {
+      return w;
+    }
+  }
+  if (n >= MAX_WINDOWS)
+  {
+    return -1;
+  }
+  windows[n].length.store(windowUs, std::memory_order_relaxed);
+  // the writer takes it over with its next frame.
+  numWindows.store(n + 1, std::memory_order_release);
+  return n;
+}
+
+void SpaceNavHistory::push(const long long timestamp, const int axes[6], const uint64_t buttons)
+{
+  const unsigned long long n = count.load(std::memory_order_relaxed);
+  const unsigned int index = n % CAPACITY;
+
+  // new windows start empty with this frame.
+  const int added = numWindows.load(std::memory_order_acquire);
+  for (; activeWindows < added; activeWindows++)
+  {
+    Window &window = windows[activeWindows];
+    window.start = n;
+    for (int a = 0; a < 6; a++)
+    {
+      window.sum[a] = 0;
+      window.sumSquares[a] = 0;
+      window.minHead[a] = minQueue[a].tail;
+      window.maxHead[a] = maxQueue[a].tail;
+    }
+  }
+
+  // the windows must not reference the slot which is about to be reused.
+  for (int w = 0; w < activeWindows; w++)
+  {
+    if (n - windows[w].start >= CAPACITY)
+    {
+      evictOldest(windows[w]);
+    }
+  }
+
+  Slot &slot = slots[index];
+  slot.version.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.timestamp.store(timestamp, std::memory_order_relaxed);
+  for (int a = 0; a < 6; a++)
+  {
+    slot.axes[a].store(axes[a], std::memory_order_relaxed);
+  }
+  slot.buttons.store(buttons, std::memory_order_relaxed);
+  slot.version.store(2 * n + 2, std::memory_order_release);
+  count.store(n + 1, std::memory_order_release);
+
+  stamps[index] = timestamp;
+  for (int a = 0; a < 6; a++)
+  {
+    values[index][a] = axes[a];
+    const unsigned long long minPosition = pushMonotonic(minQueue[a], a, n, false);
+    const unsigned long long maxPosition = pushMonotonic(maxQueue[a], a, n, true);
+    for (int w = 0; w < activeWindows; w++)
+    {
+      Window &window = windows[w];
+      window.sum[a] += axes[a];
+      window.sumSquares[a] += (long long)axes[a] * axes[a];
+      // all candidates of a shorter window were dropped, the new frame is its extreme.
+      if (window.minHead[a] > minPosition)
+      {
+        window.minHead[a] = minPosition;
+      }
+      if (window.maxHead[a] > maxPosition)
+      {
+        window.maxHead[a] = maxPosition;
+      }
+    }
+  }
+
+  for (int w = 0; w < activeWindows; w++)
+  {
+    Window &window = windows[w];
+    const long long length = window.length.load(std::memory_order_relaxed);
+    while (window.start < n && stamps[window.start % CAPACITY] < timestamp - length)
+    {
+      evictOldest(window);
+    }
+    publishWindow(window);
+  }
+}
+
+void SpaceNavHistory::evictOldest(Window &window)
+{
+  const unsigned int index = window.start % CAPACITY;
+  for (int a = 0; a < 6; a++)
+  {
+    window.sum[a] -= values[index][a];
+    window.sumSquares[a] -= (long long)values[index][a] * values[index][a];
+    if (minQueue[a].tail > window.minHead[a] && minQueue[a].entries[window.minHead[a] % CAPACITY] == window.start)
+    {
+      window.minHead[a]++;
+    }
+    if (maxQueue[a].tail > window.maxHead[a] && maxQueue[a].entries[window.maxHead[a] % CAPACITY] == window.start)
+    {
+      window.maxHead[a]++;
+    }
+  }
+  window.start++;
+}
+
+unsigned long long SpaceNavHistory::pushMonotonic(MonotonicQueue &queue, const int axis, const unsigned long long sequence, const bool keepMax)
+{
+  // drop the frames which can never be the extreme again, each frame is dropped at most once.
+  // The longest window holds at most CAPACITY frames, so the ring never overruns its oldest head.
+  const int value = values[sequence % CAPACITY][axis];
+  while (queue.tail > 0)
+  {
+    const unsigned long long back = queue.entries[(queue.tail - 1) % CAPACITY];
+    // frames before every window are never read again.
+    if (sequence - back >= CAPACITY)
+    {
+      break;
+    }
+    const int backValue = values[back % CAPACITY][axis];
+    if (keepMax ? backValue > value : backValue < value)
+    {
+      break;
+    }
+    queue.tail--;
+  }
+  const unsigned long long position = queue.tail;
+  queue.entries[position % CAPACITY] = sequence;
+  queue.tail++;
+  return position;
+}
+
+void SpaceNavHistory::publishWindow(Window &window)
+{
+  const unsigned long long n = count.load(std::memory_order_relaxed);
+  const long long frames = n - window.start;
+
+  const unsigned long long version = window.version.load(std::memory_order_relaxed);
+  window.version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  window.count.store(frames, std::memory_order_relaxed);
+  window.from.store(stamps[window.start % CAPACITY], std::memory_order_relaxed);
+  window.to.store(stamps[(n - 1) % CAPACITY], std::memory_order_relaxed);
+  for (int a = 0; a < 6; a++)
+  {
+    window.mean[a].store((double)window.sum[a] / frames, std::memory_order_relaxed);
+    // exact in integers, no cancellation.
+    window.variance[a].store((double)(frames * window.sumSquares[a] - window.sum[a] * window.sum[a]) / ((double)frames * frames), std::memory_order_relaxed);
+    window.min[a].store(values[minQueue[a].entries[window.minHead[a] % CAPACITY] % CAPACITY][a], std::memory_order_relaxed);
+    window.max[a].store(values[maxQueue[a].entries[window.maxHead[a] % CAPACITY] % CAPACITY][a], std::memory_order_relaxed);
+  }
+  window.version.store(version + 2, std::memory_order_release);
+}
+
+unsigned long long SpaceNavHistory::getCount() const
+{
+  return count.load(std::memory_order_acquire);
+}
+
+bool SpaceNavHistory::get(const unsigned long long sequence, SpaceNavHistorySample &sample) const
+{
+  if (sequence >= count.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  const Slot &slot = slots[sequence % CAPACITY];
+  const unsigned long long version = slot.version.load(std::memory_order_acquire);
+  if (version != 2 * sequence + 2)
+  {
+    return false;
+  }
+  sample.sequence = sequence;
+  sample.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+  for (int a = 0; a < 6; a++)
+  {
+    sample.axes[a] = slot.axes[a].load(std::memory_order_relaxed);
+  }
+  sample.buttons = slot.buttons.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  // an overwritten slot never becomes valid again for this sequence.
+  return slot.version.load(std::memory_order_relaxed) == version;
+}
+
+bool SpaceNavHistory::getLatest(SpaceNavHistorySample &sample) const
+{
+  for (;;)
+  {
+    const unsigned long long n = count.load(std::memory_order_acquire);
+    if (n == 0)
+    {
+      return false;
+    }
+    if (get(n - 1, sample))
+    {
+      return true;
+    }
+  }
+}
+
+long long SpaceNavHistory::timestampOf(const unsigned long long sequence) const
+{
+  const Slot &slot = slots[sequence % CAPACITY];
+  const unsigned long long version = slot.version.load(std::memory_order_acquire);
+  if (version != 2 * sequence + 2)
+  {
+    return -1;
+  }
+  const long long timestamp = slot.timestamp.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.version.load(std::memory_order_relaxed) == version ? timestamp : -1;
+}
+
+unsigned long long SpaceNavHistory::lowerBound(const long long timestamp) const
+{
+  const unsigned long long n = count.load(std::memory_order_acquire);
+  unsigned long long low = n > CAPACITY ? n - CAPACITY : 0;
+  unsigned long long high = n;
+  while (low < high)
+  {
+    const unsigned long long middle = low + (high - low) / 2;
+    const long long stamp = timestampOf(middle);
+    // frames overwritten meanwhile are older than everything still stored.
+    if (stamp < 0 || stamp < timestamp)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+unsigned int SpaceNavHistory::getRange(const long long from, const long long to, SpaceNavHistorySample *samples, const unsigned int max) const
+{
+  const unsigned long long n = count.load(std::memory_order_acquire);
+  unsigned int copied = 0;
+  for (unsigned long long sequence = lowerBound(from); sequence < n && copied < max; sequence++)
+  {
+    if (!get(sequence, samples[copied]))
+    {
+      continue;
+    }
+    if (samples[copied].timestamp > to)
+    {
+      break;
+    }
+    copied++;
+  }
+  return copied;
+}
+
+unsigned int SpaceNavHistory::getLast(const unsigned int n, SpaceNavHistorySample *samples) const
+{
+  const unsigned long long end = count.load(std::memory_order_acquire);
+  unsigned int copied = 0;
+  for (unsigned long long sequence = end > n ? end - n : 0; sequence < end; sequence++)
+  {
+    if (get(sequence, samples[copied]))
+    {
+      copied++;
+    }
+  }
+  return copied;
+}
+
+bool SpaceNavHistory::getWindow(SpaceNavHistoryWindow &window) const
+{
+  return getWindow(0, window);
+}
+
+bool SpaceNavHistory::getWindow(const int index, SpaceNavHistoryWindow &window) const
+{
+  if (index < 0 || index >= numWindows.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  const Window &source = windows[index];
+  for (;;)
+  {
+    const unsigned long long version = source.version.load(std::memory_order_acquire);
+    if (version & 1)
+    {
+      continue;
+    }
+    window.count = source.count.load(std::memory_order_relaxed);
+    window.from = source.from.load(std::memory_order_relaxed);
+    window.to = source.to.load(std::memory_order_relaxed);
+    for (int a = 0; a < 6; a++)
+    {
+      window.mean[a] = source.mean[a].load(std::memory_order_relaxed);
+      window.variance[a] = source.variance[a].load(std::memory_order_relaxed);
+      window.min[a] = source.min[a].load(std::memory_order_relaxed);
+      window.max[a] = source.max[a].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (source.version.load(std::memory_order_relaxed) == version)
+    {
+      return window.count > 0;
+    }
+  }
+}
+
+long long SpaceNavHistory::getWindowLength() const
+{
+  return getWindowLength(0);
+}
+
+long long SpaceNavHistory::getWindowLength(const int index) const
+{
+  if (index < 0 || index >= numWindows.load(std::memory_order_acquire))
+  {
+    return -1;
+  }
+  return windows[index].length.load(std::memory_order_relaxed);
+}
+
+}; // namespace hw
+
+}; // namespace cosima
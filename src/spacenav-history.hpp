@@ -0,0 +1,240 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavHistory_H_
+#define _COSIMA_SpaceNavHistory_H_
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * One committed raw frame as stored in the history.
+ */
+struct SpaceNavHistorySample
+{
+  /**
+   * Position in the history, counts every frame ever pushed.
+   */
+  unsigned long long sequence;
+  /**
+   * Kernel time stamp of the frame, in microseconds.
+   */
+  long long timestamp;
+  /**
+   * Raw axis values (tx, ty, tz, rx, ry, rz).
+   */
+  int axes[6];
+  uint64_t buttons;
+};
+
+/**
+ * Aggregates over the raw axis values of the frames in a running window.
+ */
+struct SpaceNavHistoryWindow
+{
+  unsigned int count;
+  /**
+   * Time stamps of the oldest and newest frame in the window.
+   */
+  long long from;
+  long long to;
+  double mean[6];
+  double variance[6];
+  int min[6];
+  int max[6];
+};
+
+/**
+ * Preallocated ring of the last CAPACITY frames with up to MAX_WINDOWS running time windows.
+ *
+ * There is a single writer (the thread decoding the device) and any number of readers.
+ * Readers never block the writer: every slot is guarded by its own sequence counter and a
+ * read is retried or rejected if the writer overwrote the slot meanwhile.
+ * The writer maintains the window aggregates incrementally (sums for mean and variance,
+ * monotonic queues for min and max), so push and getWindow() are O(1) per window.
+ * The windows share the monotonic queues: the candidates of a shorter window are a suffix
+ * of those of a longer one, every window only keeps its own head.
+ * Raw values are integers, which keeps the running sums exact.
+ */
+class SpaceNavHistory
+{
+public:
+  static const unsigned int CAPACITY = 1024;
+  static const int MAX_WINDOWS = 4;
+
+  /**
+   * windowUs is the length of the first running window (index 0). Every window is also
+   * bounded by CAPACITY frames.
+   */
+  explicit SpaceNavHistory(const long long windowUs);
+
+  /**
+   * Index of the running window of windowUs, added if there is none yet. A new window
+   * starts empty with the next frame. Returns -1 if all MAX_WINDOWS windows are in use.
+   * Any thread, does not block the writer.
+   */
+  int addWindow(const long long windowUs);
+
+  /**
+   * Writer only: appends a frame and updates the window.
+   */
+  void push(const long long timestamp, const int axes[6], const uint64_t buttons);
+
+  /**
+   * Number of frames pushed so far, i.e. the sequence of the next frame.
+   */
+  unsigned long long getCount() const;
+
+  /**
+   * Copies the frame with the given sequence. Returns false if it was not pushed yet
+   * or has already been overwritten.
+   */
+  bool get(const unsigned long long sequence, SpaceNavHistorySample &sample) const;
+
+  /**
+   * Copies the most recent frame. Returns false if the history is empty.
+   */
+  bool getLatest(SpaceNavHistorySample &sample) const;
+
+  /**
+   * Sequence of the oldest stored frame with a time stamp >= timestamp (binary search),
+   * getCount() if there is none.
+   */
+  unsigned long long lowerBound(const long long timestamp) const;
+
+  /**
+   * Copies the stored frames with from <= time stamp <= to, oldest first.
+   * Returns the number of frames copied, at most max.
+   */
+  unsigned int getRange(const long long from, const long long to, SpaceNavHistorySample *samples, const unsigned int max) const;
+
+  /**
+   * Copies the last n frames, oldest first. Returns the number of frames copied.
+   */
+  unsigned int getLast(const unsigned int n, SpaceNavHistorySample *samples) const;
+
+  /**
+   * Consistent snapshot of the aggregates of the first window. Returns false if it is empty.
+   */
+  bool getWindow(SpaceNavHistoryWindow &window) const;
+
+  /**
+   * Consistent snapshot of the aggregates of a window returned by addWindow().
+   * Returns false if the window is unknown or empty.
+   */
+  bool getWindow(const int index, SpaceNavHistoryWindow &window) const;
+
+  long long getWindowLength() const;
+
+  long long getWindowLength(const int index) const;
+
+private:
+  struct Slot
+  {
+    /**
+     * 2 * sequence + 1 while the frame is written, 2 * sequence + 2 once it is complete.
+     */
+    std::atomic<unsigned long long> version;
+    std::atomic<long long> timestamp;
+    std::atomic<int> axes[6];
+    std::atomic<uint64_t> buttons;
+  };
+
+  /**
+   * Indices of the frames which can still become the minimum (or maximum) of the longest
+   * window. The windows read it from their own head up to tail.
+   */
+  struct MonotonicQueue
+  {
+    unsigned long long entries[CAPACITY];
+    unsigned long long tail;
+  };
+
+  struct Window
+  {
+    std::atomic<long long> length;
+    // writer side.
+    unsigned long long start;
+    long long sum[6];
+    long long sumSquares[6];
+    unsigned long long minHead[6];
+    unsigned long long maxHead[6];
+    // published aggregates, guarded by version (odd while writing).
+    std::atomic<unsigned long long> version;
+    std::atomic<unsigned int> count;
+    std::atomic<long long> from;
+    std::atomic<long long> to;
+    std::atomic<double> mean[6];
+    std::atomic<double> variance[6];
+    std::atomic<int> min[6];
+    std::atomic<int> max[6];
+  };
+
+  void evictOldest(Window &window);
+
+  /**
+   * Returns the position of the new entry in the queue.
+   */
+  unsigned long long pushMonotonic(MonotonicQueue &queue, const int axis, const unsigned long long sequence, const bool keepMax);
+
+  void publishWindow(Window &window);
+
+  /**
+   * Timestamp of the stored frame, -1 if it was overwritten while reading.
+   */
+  long long timestampOf(const unsigned long long sequence) const;
+
+  Slot slots[CAPACITY];
+  std::atomic<unsigned long long> count;
+
+  // writer side, private copy of the frames for the window bookkeeping.
+  long long stamps[CAPACITY];
+  int values[CAPACITY][6];
+  MonotonicQueue minQueue[6];
+  MonotonicQueue maxQueue[6];
+
+  Window windows[MAX_WINDOWS];
+  /**
+   * Windows added so far (any thread, under windowsMutex) and the ones the writer
+   * took over, which starts them empty with its next frame.
+   */
+  std::atomic<int> numWindows;
+  int activeWindows;
+  std::mutex windowsMutex;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
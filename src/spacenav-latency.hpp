@@ -0,0 +1,94 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavLatency_H_
+#define _COSIMA_SpaceNavLatency_H_
+
+#include <vector>
+#include <math.h>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Latency histogram with 1 us buckets up to 100 ms. All memory is allocated
+ * in the constructor, add() is constant time.
+ */
+class SpaceNavLatencyHistogram
+{
+public:
+  SpaceNavLatencyHistogram() : buckets(100001, 0), count(0), sum(0), max(0) {}
+
+  void add(long long us)
+  {
+    if (us < 0)
+    {
+      us = 0;
+    }
+    buckets[us < (long long)buckets.size() - 1 ? us : buckets.size() - 1]++;
+    max = us > max ? us : max;
+    sum += us;
+    count++;
+  }
+
+  long long percentile(const double p) const
+  {
+    if (count == 0)
+    {
+      return 0;
+    }
+    const unsigned long target = (unsigned long)ceil(p * count);
+    unsigned long accumulated = 0;
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+      accumulated += buckets[i];
+      if (accumulated >= target)
+      {
+        return i;
+      }
+    }
+    return max;
+  }
+
+  double mean() const
+  {
+    return count ? (double)sum / count : 0.0;
+  }
+
+  std::vector<unsigned long> buckets;
+  unsigned long count;
+  long long sum;
+  long long max;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
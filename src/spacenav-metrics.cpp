@@ -0,0 +1,197 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#include "spacenav-metrics.hpp"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+namespace
+{
+
+struct MetricDescription
+{
+  const char *name;
+  const char *label;
+  const char *help;
+};
+
+// metrics of the same family need to be adjacent.
+const MetricDescription descriptions[SPACENAV_METRIC_COUNT] = {
+    {"spacenav_reads_total", "", "Reads from the device which returned data."},
+    {"spacenav_read_bytes_total", "", "Bytes read from the device."},
+    {"spacenav_events_total", "type=\"syn\"", "Input events by type."},
+    {"spacenav_events_total", "type=\"key\"", "Input events by type."},
+    {"spacenav_events_total", "type=\"rel\"", "Input events by type."},
+    {"spacenav_events_total", "type=\"abs\"", "Input events by type."},
+    {"spacenav_events_total", "type=\"other\"", "Input events by type."},
+    {"spacenav_empty_reads_total", "", "Reads which returned no data."},
+    {"spacenav_short_reads_total", "", "Reads which were not a multiple of an input event."},
+    {"spacenav_syn_dropped_total", "", "Kernel event buffer overruns (SYN_DROPPED)."},
+    {"spacenav_led_writes_total", "", "Successful LED writes."},
+    {"spacenav_port_writes_total", "", "Writes to the output ports of the component."},
+    {"spacenav_threshold_suppressed_total", "", "Non-zero axis values suppressed by the sensitivity threshold."},
+    {"spacenav_reconnects_total", "", "Device opens after the first one."}};
+
+} // namespace
+
+SpaceNavMetrics::SpaceNavMetrics()
+{
+  for (int i = 0; i < SPACENAV_METRIC_COUNT; i++)
+  {
+    counters[i].value.store(0, std::memory_order_relaxed);
+  }
+}
+
+void SpaceNavMetrics::snapshot(SpaceNavMetricsSnapshot &snapshot) const
+{
+  for (int i = 0; i < SPACENAV_METRIC_COUNT; i++)
+  {
+    snapshot.values[i] = counters[i].value.load(std::memory_order_relaxed);
+  }
+}
+
+const char *SpaceNavMetrics::getName(const SpaceNavMetric metric)
+{
+  return descriptions[metric].name;
+}
+
+const char *SpaceNavMetrics::getLabel(const SpaceNavMetric metric)
+{
+  return descriptions[metric].label;
+}
+
+const char *SpaceNavMetrics::getHelp(const SpaceNavMetric metric)
+{
+  return descriptions[metric].help;
+}
+
+SpaceNavMetricsExporter::SpaceNavMetricsExporter() : metrics(NULL),
+                                                     periodMs(1000),
+                                                     running(false)
+{
+}
+
+SpaceNavMetricsExporter::~SpaceNavMetricsExporter()
+{
+  stop();
+}
+
+bool SpaceNavMetricsExporter::start(const SpaceNavMetrics *m, const std::string &p, const unsigned int period, const std::string &c)
+{
+  stop();
+  if (!m || p.empty() || period == 0)
+  {
+    return false;
+  }
+  metrics = m;
+  path = p;
+  periodMs = period;
+  component = c;
+  running = true;
+  thread = std::thread(&SpaceNavMetricsExporter::run, this);
+  return true;
+}
+
+void SpaceNavMetricsExporter::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running)
+    {
+      return;
+    }
+    running = false;
+  }
+  wakeup.notify_all();
+  thread.join();
+}
+
+bool SpaceNavMetricsExporter::isRunning()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return running;
+}
+
+void SpaceNavMetricsExporter::run()
+{
+  SpaceNavMetricsSnapshot snapshot;
+  bool failed = false;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (running)
+  {
+    metrics->snapshot(snapshot);
+    lock.unlock();
+    const bool ok = write(snapshot, path, component);
+    if (!ok && !failed)
+    {
+      std::cout << "[SpaceNavHID] " << "Unable to write metrics to " << path << std::endl;
+    }
+    failed = !ok;
+    lock.lock();
+    wakeup.wait_for(lock, std::chrono::milliseconds(periodMs));
+  }
+}
+
+bool SpaceNavMetricsExporter::write(const SpaceNavMetricsSnapshot &snapshot, const std::string &path, const std::string &component)
+{
+  // the collector must never see a partially written file.
+  const std::string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "w");
+  if (!file)
+  {
+    return false;
+  }
+  for (int i = 0; i < SPACENAV_METRIC_COUNT; i++)
+  {
+    const MetricDescription &d = descriptions[i];
+    if (i == 0 || std::string(d.name) != descriptions[i - 1].name)
+    {
+      fprintf(file, "# HELP %s %s\n# TYPE %s counter\n", d.name, d.help, d.name);
+    }
+    fprintf(file, "%s{component=\"%s\"%s%s} %llu\n", d.name, component.c_str(), d.label[0] ? "," : "", d.label, snapshot.values[i]);
+  }
+  const bool ok = fflush(file) == 0 && !ferror(file);
+  if (fclose(file) != 0 || !ok || rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+}; // namespace hw
+
+}; // namespace cosima
@@ -0,0 +1,155 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#ifndef _COSIMA_SpaceNavMetrics_H_
+#define _COSIMA_SpaceNavMetrics_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+enum SpaceNavMetric
+{
+  SPACENAV_METRIC_READS = 0,            // reads which returned data
+  SPACENAV_METRIC_BYTES,                // bytes read
+  SPACENAV_METRIC_EVENTS_SYN,           // events by type, in the order of EV_SYN ... EV_ABS
+  SPACENAV_METRIC_EVENTS_KEY,
+  SPACENAV_METRIC_EVENTS_REL,
+  SPACENAV_METRIC_EVENTS_ABS,
+  SPACENAV_METRIC_EVENTS_OTHER,
+  SPACENAV_METRIC_EMPTY_READS,          // wake-ups without data (EAGAIN, EOF, errors)
+  SPACENAV_METRIC_SHORT_READS,          // reads which were not a multiple of struct input_event
+  SPACENAV_METRIC_SYN_DROPPED,          // kernel buffer overruns
+  SPACENAV_METRIC_LED_WRITES,
+  SPACENAV_METRIC_PORT_WRITES,          // counted by the component
+  SPACENAV_METRIC_THRESHOLD_SUPPRESSED, // non-zero axis values below the sensitivity, counted by the component
+  SPACENAV_METRIC_RECONNECTS,           // device (re-)opened after the first successful open
+  SPACENAV_METRIC_COUNT
+};
+
+/**
+ * Copy of all counters at one point in time.
+ */
+struct SpaceNavMetricsSnapshot
+{
+  unsigned long long values[SPACENAV_METRIC_COUNT];
+};
+
+/**
+ * Monotonic counters, each on its own cache line so that incrementing one does not
+ * invalidate the others and a reader taking a snapshot touches only the lines it reads.
+ * Incrementing is a relaxed atomic add, reading never blocks the writers.
+ */
+class SpaceNavMetrics
+{
+public:
+  SpaceNavMetrics();
+
+  void add(const SpaceNavMetric metric, const unsigned long long n = 1)
+  {
+    counters[metric].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  unsigned long long get(const SpaceNavMetric metric) const
+  {
+    return counters[metric].value.load(std::memory_order_relaxed);
+  }
+
+  void snapshot(SpaceNavMetricsSnapshot &snapshot) const;
+
+  /**
+   * Prometheus metric family (e.g. spacenav_reads_total) and label (e.g. type="abs", may be empty).
+   */
+  static const char *getName(const SpaceNavMetric metric);
+
+  static const char *getLabel(const SpaceNavMetric metric);
+
+  static const char *getHelp(const SpaceNavMetric metric);
+
+private:
+  // padding instead of alignas, since C++11 new does not honour extended alignment.
+  struct Counter
+  {
+    std::atomic<unsigned long long> value;
+    char pad[64 - sizeof(std::atomic<unsigned long long>)];
+  };
+  Counter counters[SPACENAV_METRIC_COUNT];
+};
+
+/**
+ * Periodically writes the counters in the Prometheus text format to a file, for the
+ * textfile collector of node_exporter. The file is replaced atomically (write + rename).
+ * Runs in its own (non real-time) thread.
+ */
+class SpaceNavMetricsExporter
+{
+public:
+  SpaceNavMetricsExporter();
+
+  ~SpaceNavMetricsExporter();
+
+  /**
+   * Starts exporting metrics to path every periodMs. component ends up in the
+   * component label of every sample. The metrics need to outlive the exporter (or stop()).
+   */
+  bool start(const SpaceNavMetrics *metrics, const std::string &path, const unsigned int periodMs, const std::string &component);
+
+  void stop();
+
+  bool isRunning();
+
+  /**
+   * Writes one snapshot, returns false if the file could not be written.
+   */
+  static bool write(const SpaceNavMetricsSnapshot &snapshot, const std::string &path, const std::string &component);
+
+private:
+  void run();
+
+  const SpaceNavMetrics *metrics;
+  std::string path;
+  std::string component;
+  unsigned int periodMs;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  bool running;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
@@ -0,0 +1,305 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#ifndef _COSIMA_SpaceNavPredictor_H_
+#define _COSIMA_SpaceNavPredictor_H_
+
+#include <math.h>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Accumulated error of the predictions against the measurements which arrived later.
+ */
+struct SpaceNavPredictionStatistics
+{
+  unsigned long count;
+  double sumAbs[6];
+  double sumSquares[6];
+  double maxAbs[6];
+
+  double meanAbs(const int axis) const
+  {
+    return count ? sumAbs[axis] / count : 0.0;
+  }
+
+  double rms(const int axis) const
+  {
+    return count ? sqrt(sumSquares[axis] / count) : 0.0;
+  }
+
+  void reset()
+  {
+    count = 0;
+    for (int a = 0; a < 6; a++)
+    {
+      sumAbs[a] = 0;
+      sumSquares[a] = 0;
+      maxAbs[a] = 0;
+    }
+  }
+};
+
+/**
+ * Alpha-beta filter per axis over timestamped samples, extrapolating the deflection
+ * forward by the latency of the path to the robot.
+ *
+ * All state has a fixed size: update() and predict() do not allocate and their cost
+ * is bounded by PENDING, the number of predictions kept back for the error statistics.
+ */
+class SpaceNavPredictor
+{
+public:
+  static const int PENDING = 32;
+
+  /**
+   * Lower bound of the time without frames after which the device counts as silent,
+   * in microseconds, so the scheduling latency of fast devices does not stop the prediction.
+   */
+  static const long long MIN_SILENCE = 2000;
+
+  SpaceNavPredictor() : alpha(0.5), beta(0.1), limit(0), maxHorizon(100000)
+  {
+    reset();
+  }
+
+  /**
+   * Gains of the filter, 0 < alpha <= 1 and 0 < beta < 4 - 2 * alpha for a stable filter.
+   */
+  void setGains(const double a, const double b)
+  {
+    alpha = a;
+    beta = b;
+  }
+
+  /**
+   * Predictions are clamped to +-l, 0 disables the clamping.
+   */
+  void setLimit(const double l)
+  {
+    limit = l;
+  }
+
+  /**
+   * Upper bound of the extrapolation, in microseconds.
+   */
+  void setMaxHorizon(const long long us)
+  {
+    maxHorizon = us;
+  }
+
+  void reset()
+  {
+    initialized = false;
+    last = 0;
+    interval = 0;
+    for (int a = 0; a < 6; a++)
+    {
+      position[a] = 0;
+      velocity[a] = 0;
+      measurement[a] = 0;
+    }
+    pendingHead = 0;
+    pendingCount = 0;
+    statistics.reset();
+  }
+
+  /**
+   * Feeds a new measurement taken at timestamp (microseconds). Samples which are not newer
+   * than the previous one are ignored. After a gap of more than a second the filter restarts.
+   */
+  void update(const long long timestamp, const double z[6])
+  {
+    if (initialized && timestamp <= last)
+    {
+      return;
+    }
+    if (!initialized || timestamp - last > 1000000)
+    {
+      for (int a = 0; a < 6; a++)
+      {
+        position[a] = z[a];
+        velocity[a] = 0;
+        measurement[a] = z[a];
+      }
+      last = timestamp;
+      interval = 0;
+      pendingCount = 0;
+      initialized = true;
+      return;
+    }
+
+    evaluatePending(timestamp, z);
+    // running mean of the frame period, to notice when the device fell silent.
+    interval = interval > 0 ? interval + (timestamp - last - interval) / 8 : timestamp - last;
+
+    const double dt = (timestamp - last) * 1e-6;
+    for (int a = 0; a < 6; a++)
+    {
+      const double predicted = position[a] + velocity[a] * dt;
+      const double residual = z[a] - predicted;
+      position[a] = predicted + alpha * residual;
+      velocity[a] += beta / dt * residual;
+      measurement[a] = z[a];
+    }
+    last = timestamp;
+  }
+
+  /**
+   * Extrapolates the filtered deflection to now + horizon (microseconds) and remembers
+   * the prediction to compare it with the measurement which arrives for that time.
+   * The extrapolation from the last frame is bounded by the maximum horizon. A device at
+   * rest sends no frames: once none arrived for two frame periods, the filter settles on
+   * the last measurement and stops extrapolating.
+   */
+  void predict(const long long now, long long horizon, double out[6])
+  {
+    if (!initialized)
+    {
+      for (int a = 0; a < 6; a++)
+      {
+        out[a] = 0;
+      }
+      return;
+    }
+    horizon = horizon < 0 ? 0 : (horizon > maxHorizon ? maxHorizon : horizon);
+    const long long target = now + horizon;
+    long long silence = 2 * interval;
+    if (silence < MIN_SILENCE)
+    {
+      silence = MIN_SILENCE;
+    }
+    if (now - last > silence)
+    {
+      for (int a = 0; a < 6; a++)
+      {
+        position[a] = measurement[a];
+        velocity[a] = 0;
+      }
+    }
+    const long long span = target - last;
+    const double dt = (span > maxHorizon ? maxHorizon : span) * 1e-6;
+    for (int a = 0; a < 6; a++)
+    {
+      double value = position[a] + velocity[a] * dt;
+      if (limit > 0)
+      {
+        value = value > limit ? limit : (value < -limit ? -limit : value);
+      }
+      out[a] = value;
+    }
+
+    // the oldest prediction is dropped if nothing arrived for a while.
+    Prediction &slot = pending[(pendingHead + pendingCount) % PENDING];
+    slot.target = target;
+    for (int a = 0; a < 6; a++)
+    {
+      slot.values[a] = out[a];
+    }
+    if (pendingCount < PENDING)
+    {
+      pendingCount++;
+    }
+    else
+    {
+      pendingHead = (pendingHead + 1) % PENDING;
+    }
+  }
+
+  const SpaceNavPredictionStatistics &getStatistics() const
+  {
+    return statistics;
+  }
+
+  void resetStatistics()
+  {
+    statistics.reset();
+  }
+
+private:
+  struct Prediction
+  {
+    long long target;
+    double values[6];
+  };
+
+  /**
+   * Compares every prediction whose target time has passed with the measurement
+   * at that time, interpolated between the previous and the new sample.
+   */
+  void evaluatePending(const long long timestamp, const double z[6])
+  {
+    while (pendingCount > 0 && pending[pendingHead].target <= timestamp)
+    {
+      const Prediction &p = pending[pendingHead];
+      const double t = p.target <= last ? 0.0 : (double)(p.target - last) / (timestamp - last);
+      for (int a = 0; a < 6; a++)
+      {
+        const double error = fabs(p.values[a] - (measurement[a] + t * (z[a] - measurement[a])));
+        statistics.sumAbs[a] += error;
+        statistics.sumSquares[a] += error * error;
+        statistics.maxAbs[a] = error > statistics.maxAbs[a] ? error : statistics.maxAbs[a];
+      }
+      statistics.count++;
+      pendingHead = (pendingHead + 1) % PENDING;
+      pendingCount--;
+    }
+  }
+
+  double alpha;
+  double beta;
+  double limit;
+  long long maxHorizon;
+
+  bool initialized;
+  long long last;
+  /**
+   * Mean time between frames, in microseconds.
+   */
+  long long interval;
+  double position[6];
+  double velocity[6];
+  /**
+   * Last measurement, for the interpolation in evaluatePending().
+   */
+  double measurement[6];
+
+  Prediction pending[PENDING];
+  int pendingHead;
+  int pendingCount;
+  SpaceNavPredictionStatistics statistics;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
@@ -0,0 +1,166 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+
+#ifndef _COSIMA_SpaceNavShaper_H_
+#define _COSIMA_SpaceNavShaper_H_
+
+#include <math.h>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Online jerk-limited shaping of six velocity commands (x, y, z, a, b, c).
+ *
+ * Each axis follows its target velocity within the velocity, acceleration and jerk
+ * limits of the axis: the acceleration ramps towards the limit as long as ramping it
+ * down right away would not reach the target yet, and towards the opposite limit otherwise.
+ * update() is a fixed number of operations per axis, without loops or allocation.
+ */
+class SpaceNavShaper
+{
+public:
+  SpaceNavShaper()
+  {
+    for (int i = 0; i < 6; i++)
+    {
+      maxVelocity[i] = 1.0;
+      maxAcceleration[i] = 1.0;
+      maxJerk[i] = 10.0;
+    }
+    reset();
+  }
+
+  /**
+   * Returns false and keeps the previous limits unless all three are positive,
+   * a limit of 0 would freeze the axis.
+   */
+  bool setLimits(const int axis, const double velocity, const double acceleration, const double jerk)
+  {
+    if (!(velocity > 0 && acceleration > 0 && jerk > 0))
+    {
+      return false;
+    }
+    maxVelocity[axis] = velocity;
+    maxAcceleration[axis] = acceleration;
+    maxJerk[axis] = jerk;
+    return true;
+  }
+
+  /**
+   * Stops immediately, e.g. when the pose was reset.
+   */
+  void reset()
+  {
+    for (int i = 0; i < 6; i++)
+    {
+      velocity[i] = 0;
+      acceleration[i] = 0;
+    }
+  }
+
+  /**
+   * Advances all axes by dt seconds towards the target velocities and returns the shaped ones.
+   */
+  void update(const double target[6], const double dt, double shaped[6])
+  {
+    for (int i = 0; i < 6; i++)
+    {
+      shaped[i] = updateAxis(i, target[i], dt);
+    }
+  }
+
+  double getVelocity(const int axis) const
+  {
+    return velocity[axis];
+  }
+
+  double getAcceleration(const int axis) const
+  {
+    return acceleration[axis];
+  }
+
+  /**
+   * True if no axis moves or accelerates anymore.
+   */
+  bool isSettled() const
+  {
+    for (int i = 0; i < 6; i++)
+    {
+      if (velocity[i] != 0 || acceleration[i] != 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  double updateAxis(const int i, double target, const double dt)
+  {
+    if (dt <= 0)
+    {
+      return velocity[i];
+    }
+    const double jerkStep = maxJerk[i] * dt;
+    target = target > maxVelocity[i] ? maxVelocity[i] : (target < -maxVelocity[i] ? -maxVelocity[i] : target);
+
+    const double error = target - velocity[i];
+    // close enough: stop within one jerk step (the velocity step is at most jerk * dt^2).
+    if (fabs(error) <= jerkStep * dt && fabs(acceleration[i]) <= jerkStep)
+    {
+      velocity[i] = target;
+      acceleration[i] = 0;
+      return velocity[i];
+    }
+
+    // velocity which is reached if the acceleration is ramped down from now on.
+    const double braking = velocity[i] + acceleration[i] * dt + acceleration[i] * fabs(acceleration[i]) / (2.0 * maxJerk[i]);
+    const double desired = target > braking ? maxAcceleration[i] : -maxAcceleration[i];
+    const double change = desired - acceleration[i];
+    acceleration[i] += change > jerkStep ? jerkStep : (change < -jerkStep ? -jerkStep : change);
+
+    const double next = velocity[i] + acceleration[i] * dt;
+    velocity[i] = next > maxVelocity[i] ? maxVelocity[i] : (next < -maxVelocity[i] ? -maxVelocity[i] : next);
+    return velocity[i];
+  }
+
+  double maxVelocity[6];
+  double maxAcceleration[6];
+  double maxJerk[6];
+  double velocity[6];
+  double acceleration[6];
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
@@ -0,0 +1,109 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavSpscQueue_H_
+#define _COSIMA_SpaceNavSpscQueue_H_
+
+#include <atomic>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Bounded lock-free single producer / single consumer queue.
+ * The storage is allocated with the queue, push and pop never allocate.
+ * Capacity needs to be a power of two, one slot is kept free.
+ */
+template <typename T, unsigned int Capacity>
+class SpaceNavSpscQueue
+{
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity needs to be a power of two");
+
+public:
+  SpaceNavSpscQueue() : head(0), tail(0) {}
+
+  /**
+   * Called by the producer only. Returns false if the queue is full.
+   */
+  bool push(const T &item)
+  {
+    const unsigned int t = tail.load(std::memory_order_relaxed);
+    const unsigned int next = (t + 1) & (Capacity - 1);
+    if (next == head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    buffer[t] = item;
+    tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Called by the consumer only. Returns false if the queue is empty.
+   */
+  bool pop(T &item)
+  {
+    const unsigned int h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    item = buffer[h];
+    head.store((h + 1) & (Capacity - 1), std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const
+  {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Drops all queued items. Only safe while the producer is idle.
+   */
+  void clear()
+  {
+    head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+private:
+  // keep producer and consumer indices on separate cache lines.
+  // Padding instead of alignas, since C++11 new does not honour extended alignment.
+  std::atomic<unsigned int> head;
+  char padHead[64 - sizeof(std::atomic<unsigned int>)];
+  std::atomic<unsigned int> tail;
+  char padTail[64 - sizeof(std::atomic<unsigned int>)];
+  T buffer[Capacity];
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
@@ -0,0 +1,251 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-trace.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
+
+// 2^16 records of 48 bytes, a few seconds of history at full rate.
+#define TRACE_CAPACITY (1 << 16)
+// rings which are removed at a normal exit of the process.
+#define TRACE_MAX_FILES 64
+
+namespace cosima
+{
+
+namespace hw
+{
+
+namespace
+{
+
+struct ThreadRing
+{
+  SpaceNavTraceHeader *header;
+  SpaceNavTraceRecord *records;
+  bool failed;
+};
+
+thread_local ThreadRing ring = {NULL, NULL, false};
+
+/**
+ * Files of the rings still attached, removed by the exit handler. Plain storage,
+ * so it is still valid when the handler runs after the static destructors.
+ */
+std::mutex filesMutex;
+char files[TRACE_MAX_FILES][512];
+bool exitHandlerInstalled = false;
+
+void removeFiles()
+{
+  std::lock_guard<std::mutex> lock(filesMutex);
+  for (int i = 0; i < TRACE_MAX_FILES; i++)
+  {
+    if (files[i][0])
+    {
+      unlink(files[i]);
+      files[i][0] = 0;
+    }
+  }
+}
+
+/**
+ * Registers the file of a ring, returns its slot or -1 if it is kept.
+ */
+int registerFile(const char *path)
+{
+  if (getenv("SPACENAV_TRACE_KEEP"))
+  {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(filesMutex);
+  if (!exitHandlerInstalled)
+  {
+    exitHandlerInstalled = atexit(removeFiles) == 0;
+  }
+  for (int i = 0; i < TRACE_MAX_FILES; i++)
+  {
+    if (!files[i][0])
+    {
+      snprintf(files[i], sizeof files[i], "%s", path);
+      return i;
+    }
+  }
+  return -1;
+}
+
+void removeFile(const int slot)
+{
+  if (slot < 0)
+  {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(filesMutex);
+  if (files[slot][0])
+  {
+    unlink(files[slot]);
+    files[slot][0] = 0;
+  }
+}
+
+void detach()
+{
+  if (!ring.header)
+  {
+    return;
+  }
+  munmap(ring.header, sizeof(SpaceNavTraceHeader) + TRACE_CAPACITY * sizeof(SpaceNavTraceRecord));
+  ring.header = NULL;
+  ring.records = NULL;
+}
+
+/**
+ * Detaches the ring when its thread ends. Only touched on attach, the trace
+ * points access the trivially destructible ring.
+ */
+struct ThreadRingGuard
+{
+  int slot;
+
+  ~ThreadRingGuard()
+  {
+    detach();
+    removeFile(slot);
+  }
+};
+
+thread_local ThreadRingGuard guard = {-1};
+
+bool attach()
+{
+  if (ring.header)
+  {
+    return true;
+  }
+  if (ring.failed)
+  {
+    return false;
+  }
+  ring.failed = true;
+
+  const char *dir = getenv("SPACENAV_TRACE_DIR");
+  const int tid = (int)syscall(SYS_gettid);
+  char path[512];
+  snprintf(path, sizeof path, "%s/spacenav-trace.%d.%d", dir ? dir : "/dev/shm", (int)getpid(), tid);
+
+  const size_t size = sizeof(SpaceNavTraceHeader) + TRACE_CAPACITY * sizeof(SpaceNavTraceRecord);
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1)
+  {
+    return false;
+  }
+  if (ftruncate(fd, size) != 0)
+  {
+    close(fd);
+    return false;
+  }
+  // shared mapping of a file: the page cache keeps the data when the process dies.
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED)
+  {
+    return false;
+  }
+  // touch every page now instead of faulting in the traced path.
+  memset(memory, 0, size);
+
+  ring.header = (SpaceNavTraceHeader *)memory;
+  ring.records = (SpaceNavTraceRecord *)((char *)memory + sizeof(SpaceNavTraceHeader));
+  ring.header->recordSize = sizeof(SpaceNavTraceRecord);
+  ring.header->capacity = TRACE_CAPACITY;
+  ring.header->pid = getpid();
+  ring.header->tid = tid;
+  ring.header->written = 0;
+  ring.header->version = SPACENAV_TRACE_VERSION;
+  __atomic_store_n(&ring.header->magic, SPACENAV_TRACE_MAGIC, __ATOMIC_RELEASE);
+  ring.failed = false;
+  guard.slot = registerFile(path);
+  return true;
+}
+
+} // namespace
+
+void spacenavTrace(const SpaceNavTraceStage stage, const SpaceNavTraceValue a, const SpaceNavTraceValue b, const SpaceNavTraceValue c, const SpaceNavTraceValue d)
+{
+  if (!ring.header && !attach())
+  {
+    return;
+  }
+  const uint64_t index = ring.header->written;
+  SpaceNavTraceRecord &record = ring.records[index & (TRACE_CAPACITY - 1)];
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  record.time = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+  record.sequence = (uint32_t)index;
+  record.stage = stage;
+  record.integers = (uint16_t)(a.integer | (b.integer << 1) | (c.integer << 2) | (d.integer << 3));
+  record.values[0] = a.number;
+  record.values[1] = b.number;
+  record.values[2] = c.number;
+  record.values[3] = d.number;
+  // publish the record only after it is complete.
+  __atomic_store_n(&ring.header->written, index + 1, __ATOMIC_RELEASE);
+}
+
+bool spacenavTraceAttachThread()
+{
+  return attach();
+}
+
+void spacenavTraceDetachThread()
+{
+  detach();
+  removeFile(guard.slot);
+  guard.slot = -1;
+  // a later trace point attaches a new ring.
+  ring.failed = false;
+}
+
+const char *spacenavTraceStageName(const uint16_t stage)
+{
+  static const char *names[SPACENAV_TRACE_STAGE_COUNT] = {
+      "?", "read", "decode", "scale_t", "scale_r", "threshold_t", "threshold_r",
+      "command_t", "command_r", "pose_t", "pose_r", "cage", "port_write",
+      "predict_t", "predict_r"};
+  return stage < SPACENAV_TRACE_STAGE_COUNT ? names[stage] : "?";
+}
+
+} // namespace hw
+
+} // namespace cosima
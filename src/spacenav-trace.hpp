@@ -0,0 +1,162 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavTrace_H_
+#define _COSIMA_SpaceNavTrace_H_
+
+#include <stdint.h>
+#include <type_traits>
+
+/**
+ * Flight recorder for the input pipeline.
+ *
+ * SPACENAV_TRACE(STAGE, a, b, c, d) writes a fixed-size record into a ring
+ * buffer of the calling thread. The ring is a shared mapping of a file in
+ * /dev/shm (or $SPACENAV_TRACE_DIR), so it survives a crash of the process
+ * and can be decoded afterwards with spacenav-hid-trace-dump. The file is removed
+ * when the thread or the process ends normally, unless $SPACENAV_TRACE_KEEP is set.
+ * Integer arguments are recorded in full width, all others as double.
+ * Without SPACENAV_TRACING the macro compiles to nothing.
+ */
+#ifdef SPACENAV_TRACING
+#define SPACENAV_TRACE(stage, a, b, c, d) cosima::hw::spacenavTrace(cosima::hw::SPACENAV_TRACE_##stage, (a), (b), (c), (d))
+#else
+// the arguments stay unevaluated, but count as used.
+#define SPACENAV_TRACE(stage, a, b, c, d)                               \
+  do                                                                    \
+  {                                                                     \
+    (void)sizeof(((void)(a), (void)(b), (void)(c), (void)(d), 0));      \
+  } while (0)
+#endif
+
+namespace cosima
+{
+
+namespace hw
+{
+
+enum SpaceNavTraceStage
+{
+  SPACENAV_TRACE_READ = 1,    // bytes, events, dropping, errno
+  SPACENAV_TRACE_DECODE,      // frames, dropped, buttons, button edge overflows
+  SPACENAV_TRACE_SCALE_T,     // tx, ty, tz
+  SPACENAV_TRACE_SCALE_R,     // rx, ry, rz
+  SPACENAV_TRACE_THRESHOLD_T, // tx, ty, tz, sensitivity
+  SPACENAV_TRACE_THRESHOLD_R, // rx, ry, rz, sensitivity
+  SPACENAV_TRACE_COMMAND_T,   // x, y, z, translation locked
+  SPACENAV_TRACE_COMMAND_R,   // a, b, c, orientation locked
+  SPACENAV_TRACE_POSE_T,      // x, y, z, channel
+  SPACENAV_TRACE_POSE_R,      // w, x, y, z
+  SPACENAV_TRACE_CAGE,        // x, y, z, clamped
+  SPACENAV_TRACE_PORT_WRITE,  // port (0 = 6d, 1 = pose, 2 = button event, 3 = command), channel of a pose
+  SPACENAV_TRACE_PREDICT_T,   // tx, ty, tz, horizon (us)
+  SPACENAV_TRACE_PREDICT_R,   // rx, ry, rz, horizon (us)
+  SPACENAV_TRACE_STAGE_COUNT
+};
+
+union SpaceNavTraceNumber
+{
+  double real;
+  int64_t integer;
+};
+
+/**
+ * One record, 48 bytes.
+ */
+struct SpaceNavTraceRecord
+{
+  uint64_t time; // ns, CLOCK_MONOTONIC
+  uint32_t sequence;
+  uint16_t stage;
+  uint16_t integers; // bit i set: values[i] holds an integer
+  SpaceNavTraceNumber values[4];
+};
+
+/**
+ * Argument of a trace point, remembers whether it was an integer.
+ */
+struct SpaceNavTraceValue
+{
+  SpaceNavTraceNumber number;
+  bool integer;
+
+  template <typename T>
+  SpaceNavTraceValue(const T value) : integer(std::is_integral<T>::value || std::is_enum<T>::value)
+  {
+    if (integer)
+    {
+      number.integer = (int64_t)value;
+    }
+    else
+    {
+      number.real = (double)value;
+    }
+  }
+};
+
+/**
+ * Layout of the mapped file: this header, followed by capacity records.
+ */
+struct SpaceNavTraceHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t capacity; // power of two
+  int32_t pid;
+  int32_t tid;
+  /**
+   * Number of records written so far, the next record goes to written % capacity.
+   */
+  volatile uint64_t written;
+};
+
+static const uint32_t SPACENAV_TRACE_MAGIC = 0x534e5452; // "SNTR"
+static const uint32_t SPACENAV_TRACE_VERSION = 2;
+
+/**
+ * Appends a record to the ring of the calling thread, creating the ring on first use.
+ */
+void spacenavTrace(const SpaceNavTraceStage stage, const SpaceNavTraceValue a, const SpaceNavTraceValue b, const SpaceNavTraceValue c, const SpaceNavTraceValue d);
+
+/**
+ * Unmaps and removes the ring of the calling thread (also done at thread and process exit).
+ */
+void spacenavTraceDetachThread();
+
+/**
+ * Creates the ring of the calling thread ahead of time, so that the first
+ * trace point does not pay for the mapping. Returns false if tracing is unavailable.
+ */
+bool spacenavTraceAttachThread();
+
+const char *spacenavTraceStageName(const uint16_t stage);
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
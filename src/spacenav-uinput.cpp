@@ -0,0 +1,233 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-uinput.hpp"
+
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <iostream>
+
+namespace cosima
+{
+
+namespace hw
+{
+
+SpaceNavVirtualDevice::SpaceNavVirtualDevice() : fd(-1),
+                                                 numButtons(0),
+                                                 frameCount(0)
+{
+  memset(lastAxes, 0, sizeof lastAxes);
+}
+
+SpaceNavVirtualDevice::~SpaceNavVirtualDevice()
+{
+  destroy();
+}
+
+bool SpaceNavVirtualDevice::create(const SpaceNavDeviceInfo &info, const int minimum, const int maximum)
+{
+  destroy();
+
+  // read access for the LED writes of consumers.
+  fd = open("/dev/uinput", O_RDWR | O_NONBLOCK);
+  if (fd == -1)
+  {
+    perror("[SpaceNavVirtualDevice] opening /dev/uinput");
+    return false;
+  }
+
+  numButtons = info.numButtons < SpaceNavButtons::MAX_BUTTONS ? info.numButtons : SpaceNavButtons::MAX_BUTTONS;
+
+  bool ok = ioctl(fd, UI_SET_EVBIT, EV_SYN) == 0 &&
+            ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0 &&
+            ioctl(fd, UI_SET_EVBIT, EV_ABS) == 0;
+  for (int i = 0; ok && i < numButtons; i++)
+  {
+    // the codes hid-input uses for the buttons of a multi-axis controller.
+    ok = buttonIndexToCode(i) < 0 || ioctl(fd, UI_SET_KEYBIT, buttonIndexToCode(i)) == 0;
+  }
+  for (int i = 0; ok && i < info.numAxes; i++)
+  {
+    ok = ioctl(fd, UI_SET_ABSBIT, ABS_X + i) == 0;
+  }
+  if (ok && info.hasLed)
+  {
+    ok = ioctl(fd, UI_SET_EVBIT, EV_LED) == 0 && ioctl(fd, UI_SET_LEDBIT, LED_MISC) == 0;
+  }
+
+#ifdef UI_DEV_SETUP
+  for (int i = 0; ok && i < info.numAxes; i++)
+  {
+    struct uinput_abs_setup abs_setup;
+    memset(&abs_setup, 0, sizeof abs_setup);
+    abs_setup.code = ABS_X + i;
+    abs_setup.absinfo.minimum = minimum;
+    abs_setup.absinfo.maximum = maximum;
+    ok = ioctl(fd, UI_ABS_SETUP, &abs_setup) == 0;
+  }
+
+  struct uinput_setup setup;
+  memset(&setup, 0, sizeof setup);
+  setup.id.bustype = BUS_USB;
+  setup.id.vendor = info.vendor;
+  setup.id.product = info.product;
+  snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "3Dconnexion %s (virtual)", info.name);
+  ok = ok && ioctl(fd, UI_DEV_SETUP, &setup) == 0;
+#else
+  // kernels before 4.5 take the setup as a write.
+  struct uinput_user_dev user_dev;
+  memset(&user_dev, 0, sizeof user_dev);
+  user_dev.id.bustype = BUS_USB;
+  user_dev.id.vendor = info.vendor;
+  user_dev.id.product = info.product;
+  snprintf(user_dev.name, UINPUT_MAX_NAME_SIZE, "3Dconnexion %s (virtual)", info.name);
+  for (int i = 0; i < info.numAxes; i++)
+  {
+    user_dev.absmin[ABS_X + i] = minimum;
+    user_dev.absmax[ABS_X + i] = maximum;
+  }
+  ok = ok && write(fd, &user_dev, sizeof user_dev) == sizeof user_dev;
+#endif
+
+  if (!ok || ioctl(fd, UI_DEV_CREATE) != 0)
+  {
+    perror("[SpaceNavVirtualDevice] setting up the uinput device");
+    close(fd);
+    fd = -1;
+    return false;
+  }
+
+  memset(lastAxes, 0, sizeof lastAxes);
+  lastButtons.reset();
+  frameCount = 0;
+
+  std::cout << "[SpaceNavVirtualDevice] "
+            << "Created " << info.name << " (" << std::hex << info.vendor << ":" << info.product << std::dec << ")" << std::endl;
+  return true;
+}
+
+void SpaceNavVirtualDevice::destroy()
+{
+  if (fd != -1)
+  {
+    ioctl(fd, UI_DEV_DESTROY);
+    close(fd);
+  }
+  fd = -1;
+}
+
+bool SpaceNavVirtualDevice::emitFrame(const int axes[6], const SpaceNavButtons &buttons)
+{
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  struct input_event events[6 + SpaceNavButtons::MAX_BUTTONS + 1];
+  memset(events, 0, sizeof events);
+  int count = 0;
+
+  for (int i = 0; i < 6; i++)
+  {
+    if (axes[i] != lastAxes[i])
+    {
+      events[count].type = EV_ABS;
+      events[count].code = ABS_X + i;
+      events[count].value = axes[i];
+      count++;
+      lastAxes[i] = axes[i];
+    }
+  }
+
+  uint64_t changed = buttons.changed(lastButtons).bits;
+  while (changed)
+  {
+    const int index = __builtin_ctzll(changed);
+    if (index < numButtons && buttonIndexToCode(index) >= 0)
+    {
+      events[count].type = EV_KEY;
+      events[count].code = buttonIndexToCode(index);
+      events[count].value = buttons.test(index);
+      count++;
+    }
+    changed &= changed - 1;
+  }
+  lastButtons = buttons;
+
+  events[count].type = EV_SYN;
+  events[count].code = SYN_REPORT;
+  count++;
+
+  const ssize_t size = sizeof(struct input_event) * count;
+  if (write(fd, events, size) != size)
+  {
+    return false;
+  }
+  frameCount++;
+  return true;
+}
+
+bool SpaceNavVirtualDevice::readLedState(int &state)
+{
+  if (fd == -1)
+  {
+    return false;
+  }
+  bool switched = false;
+  struct input_event events[16];
+  ssize_t bytesRead;
+  while ((bytesRead = read(fd, events, sizeof events)) >= (ssize_t)sizeof(struct input_event))
+  {
+    for (int i = 0; i < (int)(bytesRead / sizeof(struct input_event)); i++)
+    {
+      if (events[i].type == EV_LED && events[i].code == LED_MISC)
+      {
+        state = events[i].value;
+        switched = true;
+      }
+    }
+  }
+  return switched;
+}
+
+int SpaceNavVirtualDevice::getFileDescriptor()
+{
+  return fd;
+}
+
+unsigned long SpaceNavVirtualDevice::getFrameCount()
+{
+  return frameCount;
+}
+
+} // namespace hw
+
+} // namespace cosima
@@ -0,0 +1,87 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavVirtualDevice_H_
+#define _COSIMA_SpaceNavVirtualDevice_H_
+
+#include "spacenav-hid.hpp"
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Virtual input device created through uinput, which looks like a real
+ * 3Dconnexion device to SpaceNavHID (vendor / product id, axes, buttons and LED).
+ */
+class SpaceNavVirtualDevice
+{
+
+public:
+  SpaceNavVirtualDevice();
+  ~SpaceNavVirtualDevice();
+
+  /**
+   * Creates the device with the ids and capabilities of info and the axis range [minimum, maximum].
+   */
+  bool create(const SpaceNavDeviceInfo &info, const int minimum, const int maximum);
+
+  void destroy();
+
+  /**
+   * Emits one frame (changed axes and buttons, followed by SYN_REPORT) with a single write.
+   * The axes are raw device values in the order tx, ty, tz, rx, ry, rz.
+   */
+  bool emitFrame(const int axes[6], const SpaceNavButtons &buttons);
+
+  /**
+   * Reads what consumers wrote to the device, non-blocking. Returns true if the LED
+   * was switched, state holds the last LED state then.
+   */
+  bool readLedState(int &state);
+
+  int getFileDescriptor();
+
+  /**
+   * Number of frames emitted since create().
+   */
+  unsigned long getFrameCount();
+
+protected:
+  int fd;
+  int numButtons;
+  int lastAxes[6];
+  SpaceNavButtons lastButtons;
+  unsigned long frameCount;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif
@@ -0,0 +1,437 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#include "spacenav-uring.hpp"
+
+#include <linux/input.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+
+#if defined(SPACENAV_HAVE_IO_URING) && !defined(XENOMAI_VERSION_MAJOR)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define USE_IO_URING
+#endif
+
+// one read collects up to 64 events per device, like getValue().
+#define BUFFER_SIZE (64 * sizeof(struct input_event))
+
+namespace cosima
+{
+
+namespace hw
+{
+
+SpaceNavUringReader::SpaceNavUringReader() : numDevices(0),
+                                             usingUring(false),
+                                             running(false),
+                                             waitCount(0),
+                                             ringFd(-1),
+                                             sqRing(NULL),
+                                             cqRing(NULL),
+                                             sqes(NULL),
+                                             sqRingSize(0),
+                                             cqRingSize(0),
+                                             sqesSize(0),
+                                             pendingSubmissions(0),
+                                             buffers(NULL)
+{
+  for (int i = 0; i < MAX_DEVICES; i++)
+  {
+    devices[i] = NULL;
+    alive[i] = false;
+  }
+}
+
+SpaceNavUringReader::~SpaceNavUringReader()
+{
+  stop();
+}
+
+bool SpaceNavUringReader::addDevice(SpaceNavHID *hid)
+{
+  if (running || numDevices == MAX_DEVICES || !hid || hid->getFileDescriptor() < 0)
+  {
+    return false;
+  }
+  devices[numDevices] = hid;
+  values[numDevices].reset();
+  rawValues[numDevices].reset();
+  alive[numDevices] = true;
+  numDevices++;
+  return true;
+}
+
+bool SpaceNavUringReader::start(const bool useUring)
+{
+  stop();
+  if (numDevices == 0)
+  {
+    return false;
+  }
+  usingUring = useUring && setupRing();
+  if (useUring && !usingUring)
+  {
+    std::cerr << "[SpaceNavUringReader] "
+              << "io_uring is not available, falling back to poll and read." << std::endl;
+  }
+  if (usingUring)
+  {
+    for (int i = 0; i < numDevices; i++)
+    {
+      queueRead(i);
+    }
+  }
+  running = true;
+  return true;
+}
+
+void SpaceNavUringReader::stop()
+{
+  teardownRing();
+  usingUring = false;
+  running = false;
+}
+
+int SpaceNavUringReader::update(const int timeoutMs)
+{
+  if (!running)
+  {
+    return -1;
+  }
+  return usingUring ? updateUring(timeoutMs) : updateFallback(timeoutMs);
+}
+
+int SpaceNavUringReader::updateFallback(const int timeoutMs)
+{
+  struct pollfd pfds[MAX_DEVICES];
+  for (int i = 0; i < numDevices; i++)
+  {
+    pfds[i].fd = alive[i] ? devices[i]->getFileDescriptor() : -1;
+    pfds[i].events = POLLIN;
+    pfds[i].revents = 0;
+  }
+  waitCount++;
+  const int ready = poll(pfds, numDevices, timeoutMs);
+  if (ready <= 0)
+  {
+    return ready < 0 && errno != EINTR ? -1 : 0;
+  }
+  int updates = 0;
+  for (int i = 0; i < numDevices; i++)
+  {
+    if (pfds[i].revents & POLLIN)
+    {
+      devices[i]->getValue(values[i], rawValues[i]);
+      updates++;
+    }
+    else if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+    {
+      alive[i] = false;
+    }
+  }
+  return updates;
+}
+
+bool SpaceNavUringReader::isUsingUring()
+{
+  return usingUring;
+}
+
+int SpaceNavUringReader::getNumDevices()
+{
+  return numDevices;
+}
+
+const SpaceNavValues &SpaceNavUringReader::getValues(const int index)
+{
+  return values[index];
+}
+
+const SpaceNavValues &SpaceNavUringReader::getRawValues(const int index)
+{
+  return rawValues[index];
+}
+
+unsigned long SpaceNavUringReader::getWaitCount()
+{
+  return waitCount;
+}
+
+#ifdef USE_IO_URING
+
+bool SpaceNavUringReader::setupRing()
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof params);
+  // a poll and a read per device are in flight at most.
+  unsigned int entries = 4;
+  while (entries < 2 * (unsigned int)numDevices)
+  {
+    entries <<= 1;
+  }
+  ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ringFd < 0)
+  {
+    ringFd = -1;
+    return false;
+  }
+  // timeouts for the wait need the extended arguments (Linux 5.11).
+  if (!(params.features & IORING_FEAT_EXT_ARG))
+  {
+    teardownRing();
+    return false;
+  }
+
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single)
+  {
+    sqRingSize = cqRingSize = (sqRingSize > cqRingSize ? sqRingSize : cqRingSize);
+  }
+  sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (sqRing == MAP_FAILED)
+  {
+    sqRing = NULL;
+    teardownRing();
+    return false;
+  }
+  if (single)
+  {
+    cqRing = sqRing;
+  }
+  else
+  {
+    cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED)
+    {
+      cqRing = NULL;
+      teardownRing();
+      return false;
+    }
+  }
+  sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    sqes = NULL;
+    teardownRing();
+    return false;
+  }
+
+  sqHead = (unsigned int *)((char *)sqRing + params.sq_off.head);
+  sqTail = (unsigned int *)((char *)sqRing + params.sq_off.tail);
+  sqMask = (unsigned int *)((char *)sqRing + params.sq_off.ring_mask);
+  sqArray = (unsigned int *)((char *)sqRing + params.sq_off.array);
+  cqHead = (unsigned int *)((char *)cqRing + params.cq_off.head);
+  cqTail = (unsigned int *)((char *)cqRing + params.cq_off.tail);
+  cqMask = (unsigned int *)((char *)cqRing + params.cq_off.ring_mask);
+  cqes = (char *)cqRing + params.cq_off.cqes;
+
+  // the kernel pins the buffers once instead of mapping them on every read.
+  void *memory = NULL;
+  if (posix_memalign(&memory, sysconf(_SC_PAGESIZE), numDevices * BUFFER_SIZE) != 0)
+  {
+    teardownRing();
+    return false;
+  }
+  buffers = (unsigned char *)memory;
+  memset(buffers, 0, numDevices * BUFFER_SIZE);
+
+  struct iovec iovecs[MAX_DEVICES];
+  int fds[MAX_DEVICES];
+  for (int i = 0; i < numDevices; i++)
+  {
+    iovecs[i].iov_base = buffers + i * BUFFER_SIZE;
+    iovecs[i].iov_len = BUFFER_SIZE;
+    fds[i] = devices[i]->getFileDescriptor();
+  }
+  if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, iovecs, numDevices) != 0 ||
+      syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_FILES, fds, numDevices) != 0)
+  {
+    teardownRing();
+    return false;
+  }
+  pendingSubmissions = 0;
+  return true;
+}
+
+void SpaceNavUringReader::teardownRing()
+{
+  // closing the ring cancels the reads in flight.
+  if (ringFd != -1)
+  {
+    close(ringFd);
+    ringFd = -1;
+  }
+  if (sqes)
+  {
+    munmap(sqes, sqesSize);
+    sqes = NULL;
+  }
+  if (cqRing && cqRing != sqRing)
+  {
+    munmap(cqRing, cqRingSize);
+  }
+  cqRing = NULL;
+  if (sqRing)
+  {
+    munmap(sqRing, sqRingSize);
+    sqRing = NULL;
+  }
+  free(buffers);
+  buffers = NULL;
+  pendingSubmissions = 0;
+}
+
+void SpaceNavUringReader::queueRead(const int index)
+{
+  // the poll keeps the read from failing with EAGAIN on the non-blocking descriptor.
+  unsigned int tail = *sqTail;
+  const unsigned int mask = *sqMask;
+
+  struct io_uring_sqe *sqe = (struct io_uring_sqe *)sqes + (tail & mask);
+  memset(sqe, 0, sizeof *sqe);
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+  sqe->fd = index;
+  sqe->poll_events = POLLIN;
+  sqe->user_data = (unsigned long long)index << 1;
+  sqArray[tail & mask] = tail & mask;
+  tail++;
+
+  sqe = (struct io_uring_sqe *)sqes + (tail & mask);
+  memset(sqe, 0, sizeof *sqe);
+  sqe->opcode = IORING_OP_READ_FIXED;
+  sqe->flags = IOSQE_FIXED_FILE;
+  sqe->fd = index;
+  sqe->addr = (unsigned long long)(buffers + index * BUFFER_SIZE);
+  sqe->len = BUFFER_SIZE;
+  sqe->buf_index = index;
+  sqe->user_data = ((unsigned long long)index << 1) | 1;
+  sqArray[tail & mask] = tail & mask;
+  tail++;
+
+  __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+  pendingSubmissions += 2;
+}
+
+int SpaceNavUringReader::updateUring(const int timeoutMs)
+{
+  // submit the re-armed reads and wait for completions in one call.
+  struct __kernel_timespec ts;
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof arg);
+  unsigned int flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+  if (timeoutMs >= 0)
+  {
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+    arg.ts = (unsigned long long)&ts;
+  }
+  waitCount++;
+  const int submitted = (int)syscall(__NR_io_uring_enter, ringFd, pendingSubmissions, timeoutMs == 0 ? 0 : 1, flags, &arg, sizeof arg);
+  if (submitted < 0)
+  {
+    if (errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+      return -1;
+    }
+  }
+  else
+  {
+    pendingSubmissions -= submitted;
+  }
+
+  int updates = 0;
+  unsigned int head = *cqHead;
+  const unsigned int tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  const unsigned int mask = *cqMask;
+  while (head != tail)
+  {
+    const struct io_uring_cqe *cqe = (const struct io_uring_cqe *)cqes + (head & mask);
+    const int index = (int)(cqe->user_data >> 1);
+    const bool isRead = cqe->user_data & 1;
+    const int res = cqe->res;
+    head++;
+
+    // only the read completes the pair.
+    if (!isRead || index >= numDevices)
+    {
+      continue;
+    }
+    if (res > 0)
+    {
+      devices[index]->processEvents(buffers + index * BUFFER_SIZE, res, values[index], rawValues[index]);
+      updates++;
+      queueRead(index);
+    }
+    else if (res == -EAGAIN || res == -EINTR || res == -ECANCELED)
+    {
+      queueRead(index);
+    }
+    else
+    {
+      // the device is gone.
+      alive[index] = false;
+    }
+  }
+  __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  return updates;
+}
+
+#else
+
+bool SpaceNavUringReader::setupRing()
+{
+  return false;
+}
+
+void SpaceNavUringReader::teardownRing()
+{
+}
+
+void SpaceNavUringReader::queueRead(const int)
+{
+}
+
+int SpaceNavUringReader::updateUring(const int timeoutMs)
+{
+  return updateFallback(timeoutMs);
+}
+
+#endif
+
+} // namespace hw
+
+} // namespace cosima
@@ -0,0 +1,130 @@
+/* ============================================================
+ *
+ * This file is a part of SpaceNav (CoSiMA) project
+ *
+ * Copyright (C) 2018 by Dennis Leroy Wigand <dwigand at cor-lab dot uni-bielefeld dot de>
+ *
+ * This file may be licensed under the terms of the
+ * GNU Lesser General Public License Version 3 (the ``LGPL''),
+ * or (at your option) any later version.
+ *
+ * Software distributed under the License is distributed
+ * on an ``AS IS'' basis, WITHOUT WARRANTY OF ANY KIND, either
+ * express or implied. See the LGPL for the specific language
+ * governing rights and limitations.
+ *
+ * You should have received a copy of the LGPL along with this
+ * program. If not, go to http://www.gnu.org/licenses/lgpl.html
+ * or write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The development of this software was supported by:
+ *   CoR-Lab, Research Institute for Cognition and Robotics
+ *     Bielefeld University
+ *
+ * ============================================================ */
+
+#ifndef _COSIMA_SpaceNavUringReader_H_
+#define _COSIMA_SpaceNavUringReader_H_
+
+#include "spacenav-hid.hpp"
+
+namespace cosima
+{
+
+namespace hw
+{
+
+/**
+ * Batched reader for several devices.
+ *
+ * With io_uring every device keeps a linked poll + read of a pre-registered
+ * buffer in flight, so one io_uring_enter() submits the re-armed reads and
+ * collects the events of all devices without a read() per descriptor.
+ * If io_uring is not available (old kernel, seccomp, Xenomai) the reader falls
+ * back to poll() and SpaceNavHID::getValue().
+ */
+class SpaceNavUringReader
+{
+
+public:
+  static const int MAX_DEVICES = 16;
+
+  SpaceNavUringReader();
+  ~SpaceNavUringReader();
+
+  /**
+   * Adds an initialized device. Needs to be called before start().
+   */
+  bool addDevice(SpaceNavHID *hid);
+
+  /**
+   * Sets up the ring and registers buffers and descriptors.
+   * useUring = false forces the fallback path.
+   */
+  bool start(const bool useUring = true);
+
+  void stop();
+
+  /**
+   * Waits up to timeoutMs (-1 = forever) for data on any device and decodes everything
+   * that arrived. Returns the number of device updates, -1 on error.
+   */
+  int update(const int timeoutMs);
+
+  bool isUsingUring();
+
+  int getNumDevices();
+
+  /**
+   * Values of device index, as returned by SpaceNavHID::getValue().
+   */
+  const SpaceNavValues &getValues(const int index);
+  const SpaceNavValues &getRawValues(const int index);
+
+  /**
+   * Number of io_uring_enter() (or poll()) calls so far.
+   */
+  unsigned long getWaitCount();
+
+protected:
+  bool setupRing();
+  void teardownRing();
+  void queueRead(const int index);
+  int updateUring(const int timeoutMs);
+  int updateFallback(const int timeoutMs);
+
+  SpaceNavHID *devices[MAX_DEVICES];
+  SpaceNavValues values[MAX_DEVICES];
+  SpaceNavValues rawValues[MAX_DEVICES];
+  bool alive[MAX_DEVICES];
+  int numDevices;
+  bool usingUring;
+  bool running;
+  unsigned long waitCount;
+
+  // io_uring state, see io_uring_setup(2).
+  int ringFd;
+  void *sqRing;
+  void *cqRing;
+  void *sqes;
+  unsigned long sqRingSize;
+  unsigned long cqRingSize;
+  unsigned long sqesSize;
+  unsigned int *sqHead;
+  unsigned int *sqTail;
+  unsigned int *sqMask;
+  unsigned int *sqArray;
+  unsigned int *cqHead;
+  unsigned int *cqTail;
+  unsigned int *cqMask;
+  void *cqes;
+  unsigned int pendingSubmissions;
+  unsigned char *buffers;
+};
+
+}; // namespace hw
+
+}; // namespace cosima
+
+#endif